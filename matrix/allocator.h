@@ -0,0 +1,343 @@
+#ifndef MATRIX_ALLOCATOR_H
+#define MATRIX_ALLOCATOR_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Counters shared by all allocators. What counts as a hit depends on the
+// allocator; in every case a miss went to the system heap.
+struct MatrixAllocatorStats {
+    std::size_t hits;        // requests served from cached memory
+    std::size_t misses;      // requests that had to allocate
+    std::size_t releases;    // blocks handed back to the system heap
+    std::size_t bytesCached; // memory held for reuse
+    std::size_t bytesInUse;  // memory handed out and not yet returned
+};
+
+// MatrixAllocator - source of matrix element buffers.
+//
+// Blocks are aligned to ALIGNMENT bytes and returned with the size they
+// were requested with. A matrix remembers the allocator it was created
+// with; matrices created without one take current(), the innermost
+// MatrixAllocatorScope on this thread, else the process default (the
+// system heap unless changed with setDefault()). That lets a scope route
+// every temporary an operation creates through a pool or arena without
+// touching the call sites.
+class MatrixAllocator {
+public:
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    virtual ~MatrixAllocator() {}
+
+    virtual void* allocate(std::size_t bytes) = 0;
+    virtual void deallocate(void* p, std::size_t bytes) = 0;
+    virtual MatrixAllocatorStats stats() const = 0;
+
+    static MatrixAllocator* current() {
+        MatrixAllocator* scoped = scopedAllocator();
+        return scoped != nullptr ? scoped : defaultAllocator();
+    }
+
+    // Process-wide fallback; null restores the system heap
+    static void setDefault(MatrixAllocator* allocator);
+
+protected:
+    static void* systemAllocate(std::size_t bytes) {
+        return ::operator new(bytes, std::align_val_t(ALIGNMENT));
+    }
+
+    static void systemDeallocate(void* p) {
+        ::operator delete(p, std::align_val_t(ALIGNMENT));
+    }
+
+private:
+    static MatrixAllocator*& scopedAllocator() {
+        static thread_local MatrixAllocator* scoped = nullptr;
+        return scoped;
+    }
+
+    static MatrixAllocator*& defaultSlot();
+    static MatrixAllocator* defaultAllocator();
+
+    friend class MatrixAllocatorScope;
+};
+
+// HeapAllocator - aligned operator new / delete, no caching. Counters are
+// relaxed atomics so the default path takes no lock.
+class HeapAllocator : public MatrixAllocator {
+private:
+    std::atomic<std::size_t> allocations;
+    std::atomic<std::size_t> frees;
+    std::atomic<std::size_t> inUse;
+
+public:
+    HeapAllocator() : allocations(0), frees(0), inUse(0) {}
+
+    static HeapAllocator& instance() {
+        static HeapAllocator heap;
+        return heap;
+    }
+
+    void* allocate(std::size_t bytes) override {
+        void* p = systemAllocate(bytes);
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        inUse.fetch_add(bytes, std::memory_order_relaxed);
+        return p;
+    }
+
+    void deallocate(void* p, std::size_t bytes) override {
+        systemDeallocate(p);
+        frees.fetch_add(1, std::memory_order_relaxed);
+        inUse.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    MatrixAllocatorStats stats() const override {
+        MatrixAllocatorStats result = MatrixAllocatorStats();
+        result.misses = allocations.load(std::memory_order_relaxed);
+        result.releases = frees.load(std::memory_order_relaxed);
+        result.bytesInUse = inUse.load(std::memory_order_relaxed);
+        return result;
+    }
+};
+
+inline MatrixAllocator*& MatrixAllocator::defaultSlot() {
+    static MatrixAllocator* slot = nullptr;
+    return slot;
+}
+
+inline MatrixAllocator* MatrixAllocator::defaultAllocator() {
+    MatrixAllocator* allocator = defaultSlot();
+    return allocator != nullptr ? allocator : &HeapAllocator::instance();
+}
+
+inline void MatrixAllocator::setDefault(MatrixAllocator* allocator) {
+    defaultSlot() = allocator;
+}
+
+// PoolAllocator - recycles freed blocks by size class.
+//
+// Requests are rounded up to one of four classes per power of two (at
+// most 25% slack) and freed blocks go onto the free list of their class
+// instead of back to the heap, so a loop producing same-shaped temporaries
+// reaches a steady state with no heap traffic at all. At most maxCached
+// bytes are kept; blocks beyond that are released. The pool must outlive
+// every matrix allocated from it, including matrices that were assigned
+// to later and kept its blocks; debug builds assert that no block is
+// outstanding when it is destroyed. Thread-safe.
+class PoolAllocator : public MatrixAllocator {
+private:
+    mutable std::mutex mutex;
+    std::vector<std::vector<void*>> freeLists;
+    std::size_t maxCached;
+    std::size_t outstanding; // blocks handed out and not yet returned
+    MatrixAllocatorStats counters;
+
+public:
+    static constexpr std::size_t DEFAULT_MAX_CACHED = std::size_t(1) << 30;
+
+    explicit PoolAllocator(std::size_t maxCachedBytes = DEFAULT_MAX_CACHED)
+        : maxCached(maxCachedBytes), outstanding(0), counters() {}
+
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    ~PoolAllocator() override {
+        assert(outstanding == 0 && "PoolAllocator destroyed while matrices still hold its blocks");
+        trim();
+    }
+
+    // Size class of a request and the block size it stands for
+    static std::size_t sizeClass(std::size_t bytes) {
+        if (bytes <= ALIGNMENT) {
+            return 0;
+        }
+        // 2^e < bytes <= 2^(e + 1), split into quarters of 2^e
+        const int e = 63 - __builtin_clzll(static_cast<unsigned long long>(bytes - 1));
+        const std::size_t base = std::size_t(1) << e;
+        const std::size_t step = base >> 2;
+        const std::size_t quarter = (bytes - base + step - 1) / step;
+        return static_cast<std::size_t>(e - 6) * 4 + quarter;
+    }
+
+    static std::size_t classBytes(std::size_t index) {
+        if (index == 0) {
+            return ALIGNMENT;
+        }
+        const int e = static_cast<int>((index - 1) / 4) + 6;
+        const std::size_t quarter = (index - 1) % 4 + 1;
+        const std::size_t base = std::size_t(1) << e;
+        return base + quarter * (base >> 2);
+    }
+
+    void* allocate(std::size_t bytes) override {
+        const std::size_t index = sizeClass(bytes);
+        const std::size_t size = classBytes(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outstanding++;
+            counters.bytesInUse += size;
+            if (index < freeLists.size() && !freeLists[index].empty()) {
+                void* p = freeLists[index].back();
+                freeLists[index].pop_back();
+                counters.hits++;
+                counters.bytesCached -= size;
+                return p;
+            }
+            counters.misses++;
+        }
+        return systemAllocate(size);
+    }
+
+    void deallocate(void* p, std::size_t bytes) override {
+        const std::size_t index = sizeClass(bytes);
+        const std::size_t size = classBytes(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outstanding--;
+            counters.bytesInUse -= size;
+            if (counters.bytesCached + size <= maxCached) {
+                if (index >= freeLists.size()) {
+                    freeLists.resize(index + 1);
+                }
+                freeLists[index].push_back(p);
+                counters.bytesCached += size;
+                return;
+            }
+            counters.releases++;
+        }
+        systemDeallocate(p);
+    }
+
+    // Return every cached block to the heap
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::vector<void*>& list : freeLists) {
+            counters.releases += list.size();
+            for (void* p : list) {
+                systemDeallocate(p);
+            }
+            list.clear();
+        }
+        counters.bytesCached = 0;
+    }
+
+    MatrixAllocatorStats stats() const override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+
+    // Blocks handed out and not yet deallocated
+    std::size_t outstandingBlocks() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return outstanding;
+    }
+};
+
+// ArenaAllocator - monotonic allocation for batch lifetimes.
+//
+// Blocks are carved from large chunks with a pointer bump and deallocate()
+// does nothing; reset() makes all chunks available again at once. Every
+// matrix allocated from the arena must be gone (or never used again)
+// before reset(). Thread-safe.
+class ArenaAllocator : public MatrixAllocator {
+private:
+    struct Chunk {
+        char* base;
+        std::size_t size;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Chunk> chunks;
+    std::size_t chunkSize;
+    std::size_t active; // chunk currently bumped from
+    std::size_t offset; // first free byte in chunks[active]
+    MatrixAllocatorStats counters;
+
+public:
+    static constexpr std::size_t DEFAULT_CHUNK = std::size_t(64) << 20;
+
+    explicit ArenaAllocator(std::size_t chunkBytes = DEFAULT_CHUNK)
+        : chunkSize(chunkBytes), active(0), offset(0), counters() {}
+
+    ArenaAllocator(const ArenaAllocator&) = delete;
+    ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+    ~ArenaAllocator() override {
+        for (const Chunk& chunk : chunks) {
+            systemDeallocate(chunk.base);
+        }
+    }
+
+    void* allocate(std::size_t bytes) override {
+        const std::size_t size = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.bytesInUse += size;
+        // Move on through chunks kept from before the last reset()
+        while (active < chunks.size()) {
+            if (offset + size <= chunks[active].size) {
+                void* p = chunks[active].base + offset;
+                offset += size;
+                counters.hits++;
+                counters.bytesCached -= size;
+                return p;
+            }
+            counters.bytesCached -= chunks[active].size - offset;
+            active++;
+            offset = 0;
+        }
+        Chunk chunk;
+        chunk.size = size > chunkSize ? size : chunkSize;
+        chunk.base = static_cast<char*>(systemAllocate(chunk.size));
+        chunks.push_back(chunk);
+        active = chunks.size() - 1;
+        offset = size;
+        counters.misses++;
+        counters.bytesCached += chunk.size - size;
+        return chunk.base;
+    }
+
+    void deallocate(void*, std::size_t) override {}
+
+    // Recycle every chunk for the next batch
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        active = 0;
+        offset = 0;
+        counters.bytesInUse = 0;
+        counters.bytesCached = 0;
+        for (const Chunk& chunk : chunks) {
+            counters.bytesCached += chunk.size;
+        }
+    }
+
+    MatrixAllocatorStats stats() const override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+};
+
+// MatrixAllocatorScope - makes an allocator current() on this thread for
+// the lifetime of the scope; scopes nest
+class MatrixAllocatorScope {
+private:
+    MatrixAllocator* previous;
+
+public:
+    explicit MatrixAllocatorScope(MatrixAllocator& allocator)
+        : previous(MatrixAllocator::scopedAllocator()) {
+        MatrixAllocator::scopedAllocator() = &allocator;
+    }
+
+    MatrixAllocatorScope(const MatrixAllocatorScope&) = delete;
+    MatrixAllocatorScope& operator=(const MatrixAllocatorScope&) = delete;
+
+    ~MatrixAllocatorScope() {
+        MatrixAllocator::scopedAllocator() = previous;
+    }
+};
+
+#endif // MATRIX_ALLOCATOR_H
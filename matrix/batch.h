@@ -0,0 +1,261 @@
+#ifndef MATRIX_BATCH_H
+#define MATRIX_BATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "simd.h"
+#include "thread_pool.h"
+#include "utility.h"
+
+template <typename T, typename Acc>
+class BatchOperations;
+
+// MatrixBatch - many small matrices of one shape, stored interleaved.
+//
+// Element (row, col) of every matrix in the batch sits in one contiguous
+// plane, plane(row, col)[index], so the batch holds rows * cols planes of
+// size() values each. The planes are the rows of a single BasicMatrix and
+// inherit its alignment and padding: a batch is one allocation however
+// many matrices it holds, and an operation on it runs each small-matrix
+// step across the whole batch at once, which is what lets the SIMD
+// kernels fill their lanes when the matrices themselves are 3x3.
+template <typename T>
+class MatrixBatch {
+private:
+    int rows;
+    int cols;
+    BasicMatrix<T> planes; // rows * cols planes by count matrices
+
+    template <typename U, typename A>
+    friend class BatchOperations;
+
+public:
+    typedef T value_type;
+
+    MatrixBatch() : rows(0), cols(0) {}
+
+    // count zero matrices of r x c
+    MatrixBatch(int count, int r, int c)
+        : rows(count > 0 && r > 0 && c > 0 ? r : 0),
+          cols(count > 0 && r > 0 && c > 0 ? c : 0),
+          planes(rows * cols, rows > 0 ? count : 0) {}
+
+    static MatrixBatch fromMatrices(const std::vector<BasicMatrix<T>>& matrices) {
+        if (matrices.empty()) {
+            return MatrixBatch();
+        }
+        MatrixBatch result(static_cast<int>(matrices.size()), matrices[0].getRows(), matrices[0].getCols());
+        for (std::size_t index = 0; index < matrices.size(); index++) {
+            if (!result.setMatrix(static_cast<int>(index), matrices[index])) {
+                return MatrixBatch();
+            }
+        }
+        return result;
+    }
+
+    int size() const { return planes.getCols(); }
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    bool isEmpty() const { return size() == 0; }
+
+    // Element (row, col) of every matrix, size() values
+    T* plane(int row, int col) { return planes.data() + static_cast<std::size_t>(row * cols + col) * planes.stride(); }
+    const T* plane(int row, int col) const {
+        return planes.data() + static_cast<std::size_t>(row * cols + col) * planes.stride();
+    }
+
+    T getElement(int index, int row, int col) const {
+        if (index < 0 || index >= size() || row < 0 || row >= rows || col < 0 || col >= cols) {
+            std::cout << "Error: Batch element out of bounds!\n";
+            return T();
+        }
+        return plane(row, col)[index];
+    }
+
+    void setElement(int index, int row, int col, T value) {
+        if (index < 0 || index >= size() || row < 0 || row >= rows || col < 0 || col >= cols) {
+            std::cout << "Error: Batch element out of bounds!\n";
+            return;
+        }
+        plane(row, col)[index] = value;
+    }
+
+    // Gather one matrix of the batch
+    BasicMatrix<T> matrix(int index) const {
+        if (index < 0 || index >= size()) {
+            std::cout << "Error: Batch index " << index << " out of range!\n";
+            return BasicMatrix<T>();
+        }
+        BasicMatrix<T> result(rows, cols);
+        for (int i = 0; i < rows; i++) {
+            T* row = result.data() + static_cast<std::size_t>(i) * result.stride();
+            for (int j = 0; j < cols; j++) {
+                row[j] = plane(i, j)[index];
+            }
+        }
+        return result;
+    }
+
+    // Scatter matrix1 into slot index
+    bool setMatrix(int index, const BasicMatrix<T>& matrix1) {
+        if (index < 0 || index >= size()) {
+            std::cout << "Error: Batch index " << index << " out of range!\n";
+            return false;
+        }
+        if (matrix1.getRows() != rows || matrix1.getCols() != cols) {
+            std::cout << "Error: Matrix " << matrix1.getRows() << "x" << matrix1.getCols()
+                      << " does not match batch shape " << rows << "x" << cols << "!\n";
+            return false;
+        }
+        for (int i = 0; i < rows; i++) {
+            const T* row = matrix1.data() + static_cast<std::size_t>(i) * matrix1.stride();
+            for (int j = 0; j < cols; j++) {
+                plane(i, j)[index] = row[j];
+            }
+        }
+        return true;
+    }
+};
+
+// BatchOperations - elementwise and product kernels over whole batches.
+//
+// Each operation walks the batch in chunks of BATCH_CHUNK matrices and,
+// within a chunk, applies the small-matrix algorithm plane by plane: a sum
+// is one SIMD add per element, a product accumulates C(i, j) += A(i, k)
+// B(k, j) with the multiplyAdd kernel across the chunk. A chunk of every
+// operand plane stays in cache while it is used, and chunks are spread
+// over the ThreadPool once the batch is large enough to pay for it.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+class BatchOperations {
+public:
+    typedef MatrixBatch<T> Batch;
+    typedef MatrixBatch<Acc> ProductBatch;
+
+    // Matrices per chunk; a multiple of the widest SIMD vector
+    static constexpr int BATCH_CHUNK = 256;
+    // Element operations below which a call stays on the calling thread
+    static constexpr std::size_t PARALLEL_WORK = 1 << 16;
+
+    static Batch add(const Batch& batch1, const Batch& batch2) {
+        if (!sameShape(batch1, batch2, "addition")) {
+            return Batch();
+        }
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        return elementwise(batch1, [&](Batch& result, int i, int j, int begin, int count) {
+            kernels.add(batch1.plane(i, j) + begin, batch2.plane(i, j) + begin, result.plane(i, j) + begin, count);
+        });
+    }
+
+    static Batch subtract(const Batch& batch1, const Batch& batch2) {
+        if (!sameShape(batch1, batch2, "subtraction")) {
+            return Batch();
+        }
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        return elementwise(batch1, [&](Batch& result, int i, int j, int begin, int count) {
+            kernels.subtract(batch1.plane(i, j) + begin, batch2.plane(i, j) + begin, result.plane(i, j) + begin,
+                             count);
+        });
+    }
+
+    static Batch scalarMultiply(const Batch& batch1, T scalar) {
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        return elementwise(batch1, [&](Batch& result, int i, int j, int begin, int count) {
+            kernels.scale(batch1.plane(i, j) + begin, scalar, result.plane(i, j) + begin, count);
+        });
+    }
+
+    // Transposing permutes whole planes
+    static Batch transpose(const Batch& batch1) {
+        Batch result(batch1.size(), batch1.cols, batch1.rows);
+        forBatchChunks(batch1.size(), static_cast<std::size_t>(batch1.size()) * batch1.rows * batch1.cols,
+                       [&](int begin, int end) {
+            for (int i = 0; i < batch1.rows; i++) {
+                for (int j = 0; j < batch1.cols; j++) {
+                    std::copy(batch1.plane(i, j) + begin, batch1.plane(i, j) + end, result.plane(j, i) + begin);
+                }
+            }
+        });
+        return result;
+    }
+
+    // result[b] = batch1[b] * batch2[b] for every b
+    static ProductBatch multiply(const Batch& batch1, const Batch& batch2) {
+        if (batch1.size() != batch2.size() || batch1.cols != batch2.rows) {
+            std::cout << "Error: Batches must hold as many matrices, with first matrix columns equal to second "
+                         "matrix rows, for multiplication!\n";
+            std::cout << "Batch 1: " << batch1.size() << " x " << batch1.rows << "x" << batch1.cols << "\n";
+            std::cout << "Batch 2: " << batch2.size() << " x " << batch2.rows << "x" << batch2.cols << "\n";
+            return ProductBatch();
+        }
+        ProductBatch result(batch1.size(), batch1.rows, batch2.cols);
+        const std::size_t work = static_cast<std::size_t>(batch1.size()) * batch1.rows * batch1.cols * batch2.cols;
+        forBatchChunks(batch1.size(), work, [&](int begin, int end) {
+            for (int i = 0; i < batch1.rows; i++) {
+                for (int j = 0; j < batch2.cols; j++) {
+                    for (int k = 0; k < batch1.cols; k++) {
+                        multiplyAdd(batch1.plane(i, k) + begin, batch2.plane(k, j) + begin,
+                                    result.plane(i, j) + begin, end - begin, std::is_same<T, Acc>());
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+private:
+    static bool sameShape(const Batch& batch1, const Batch& batch2, const char* operation) {
+        if (batch1.size() != batch2.size() || batch1.rows != batch2.rows || batch1.cols != batch2.cols) {
+            std::cout << "Error: Batches must have same size and matrix dimensions for " << operation << "!\n";
+            return false;
+        }
+        return true;
+    }
+
+    // body(result, i, j, begin, count) fills plane (i, j) of the chunk
+    template <typename Body>
+    static Batch elementwise(const Batch& batch1, const Body& body) {
+        Batch result(batch1.size(), batch1.rows, batch1.cols);
+        forBatchChunks(batch1.size(), static_cast<std::size_t>(batch1.size()) * batch1.rows * batch1.cols,
+                       [&](int begin, int end) {
+            for (int i = 0; i < batch1.rows; i++) {
+                for (int j = 0; j < batch1.cols; j++) {
+                    body(result, i, j, begin, end - begin);
+                }
+            }
+        });
+        return result;
+    }
+
+    static void multiplyAdd(const T* a, const T* b, Acc* c, int count, std::true_type) {
+        SimdDispatch::kernels<T>().multiplyAdd(a, b, c, count);
+    }
+
+    // Widening accumulation has no kernel; the loop is still contiguous
+    static void multiplyAdd(const T* a, const T* b, Acc* c, int count, std::false_type) {
+        for (int p = 0; p < count; p++) {
+            c[p] += static_cast<Acc>(a[p]) * static_cast<Acc>(b[p]);
+        }
+    }
+
+    // body(begin, end) over ranges of whole chunks of the batch
+    template <typename Body>
+    static void forBatchChunks(int count, std::size_t work, const Body& body) {
+        ThreadPool& pool = ThreadPool::instance();
+        const int chunks = (count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+        if (work < PARALLEL_WORK || pool.size() == 1 || chunks < 2) {
+            for (int c = 0; c < chunks; c++) {
+                body(c * BATCH_CHUNK, std::min(count, (c + 1) * BATCH_CHUNK));
+            }
+            return;
+        }
+        pool.parallelFor(chunks, 0, [&](int c) {
+            body(c * BATCH_CHUNK, std::min(count, (c + 1) * BATCH_CHUNK));
+        });
+    }
+};
+
+#endif // MATRIX_BATCH_H
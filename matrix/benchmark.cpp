@@ -0,0 +1,366 @@
+// Benchmark for BasicMatrix / BasicMatrixOperations.
+//
+// Sweeps square sizes and times add, subtract, scalarMultiply, multiply,
+// transpose and isEqual, reporting per size
+//
+//     ns_per_op   wall time of one call
+//     gops        arithmetic operations per second (2n^3 for multiply,
+//                 n^2 for the elementwise operations, 0 for transpose)
+//     gbps        compulsory traffic per second (operands read once,
+//                 result written once)
+//     peak        fraction of the machine peak measured at startup:
+//                 multiply against multiply-add throughput, everything
+//                 else against memory bandwidth. Cache-resident sizes can
+//                 exceed 1 on the bandwidth side.
+//
+// Output is CSV (default) or JSON. Rows carry the SIMD level and thread
+// count, so runs under different MATRIX_SIMD / MATRIX_NUM_THREADS settings
+// or builds can be concatenated and compared directly.
+//
+//     g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark
+//     ./benchmark --format json --type float --max-size 4096
+
+#include "utility.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct BenchmarkOptions {
+    string format = "csv";
+    string type = "int";
+    string label;
+    vector<string> ops = { "add", "subtract", "scalarMultiply", "multiply", "transpose", "isEqual" };
+    int minSize = 4;
+    int maxSize = 16384;
+    int maxMultiplySize = 4096; // 16k^3 products take minutes each
+    double minTime = 0.2;       // seconds of calls per measurement
+};
+
+struct BenchmarkResult {
+    string op;
+    int size;
+    double nsPerOp;
+    double gops;
+    double gbps;
+    double peak;
+};
+
+struct MachinePeak {
+    double gops; // multiply-add throughput for the element type
+    double gbps; // copy bandwidth
+};
+
+typedef chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Multiply-add throughput: 12 independent accumulator chains per thread
+// keep every vector unit busy regardless of latency
+template <typename T, int Bytes>
+MATRIX_ALWAYS_INLINE T multiplyAddLoop(long iterations, T scale, T offset) {
+    typedef T Vec __attribute__((vector_size(Bytes)));
+    Vec acc[12];
+    for (int k = 0; k < 12; k++) {
+        acc[k] = Vec{} + static_cast<T>(k);
+    }
+    const Vec x = Vec{} + scale;
+    const Vec y = Vec{} + offset;
+    for (long it = 0; it < iterations; it++) {
+        // Unrolled so the accumulators stay in registers
+#pragma GCC unroll 12
+        for (int k = 0; k < 12; k++) {
+            acc[k] = acc[k] * x + y;
+        }
+    }
+    Vec total = Vec{};
+    for (int k = 0; k < 12; k++) {
+        total += acc[k];
+    }
+    T lanes[Bytes / sizeof(T)];
+    memcpy(lanes, &total, sizeof(lanes));
+    return lanes[0];
+}
+
+#if defined(MATRIX_SIMD_X86)
+template <typename T>
+MATRIX_TARGET("avx512f,avx512bw") T multiplyAddAvx512(long n, T s, T o) { return multiplyAddLoop<T, 64>(n, s, o); }
+template <typename T>
+MATRIX_TARGET("avx2,fma") T multiplyAddAvx2(long n, T s, T o) { return multiplyAddLoop<T, 32>(n, s, o); }
+template <typename T>
+MATRIX_TARGET("sse4.2") T multiplyAddSse42(long n, T s, T o) { return multiplyAddLoop<T, 16>(n, s, o); }
+#endif
+
+// Operations per iteration are 2 * 12 * lanes
+template <typename T>
+static int multiplyAddWidth(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Avx512: return 64;
+        case SimdLevel::Avx2:   return 32;
+        case SimdLevel::Sse42:  return 16;
+        default:                return static_cast<int>(sizeof(T));
+    }
+}
+
+template <typename T>
+static T multiplyAdd(SimdLevel level, long n, T s, T o) {
+#if defined(MATRIX_SIMD_X86)
+    switch (level) {
+        case SimdLevel::Avx512: return multiplyAddAvx512<T>(n, s, o);
+        case SimdLevel::Avx2:   return multiplyAddAvx2<T>(n, s, o);
+        case SimdLevel::Sse42:  return multiplyAddSse42<T>(n, s, o);
+        default:                break;
+    }
+#endif
+    return multiplyAddLoop<T, sizeof(T)>(n, s, o);
+}
+
+template <typename T>
+static MachinePeak measurePeak() {
+    MachinePeak peak;
+    ThreadPool& pool = ThreadPool::instance();
+    const int threads = pool.size();
+    const SimdLevel level = SimdDispatch::level();
+
+    // Scale and offset are opaque to the optimizer, so the loop cannot be
+    // folded away
+    volatile T scale = T(1);
+    volatile T offset = T(0);
+    vector<T> sink(static_cast<size_t>(threads));
+    const long iterations = 1L << 24;
+    double best = 1e30;
+    for (int rep = 0; rep < 3; rep++) {
+        const Clock::time_point start = Clock::now();
+        pool.parallelFor(threads, 0, [&](int t) { sink[t] = multiplyAdd<T>(level, iterations, scale, offset); });
+        best = min(best, secondsSince(start));
+    }
+    const double lanes = static_cast<double>(multiplyAddWidth<T>(level)) / sizeof(T);
+    peak.gops = 2.0 * 12 * lanes * iterations * threads / best * 1e-9;
+
+    // Copy bandwidth on buffers well beyond the last-level cache, split
+    // across all threads; a copy reads and writes every byte
+    const size_t bytes = max<size_t>(CacheInfo::detect().l3 * 4, size_t(64) << 20);
+    vector<char> from(bytes, 1);
+    vector<char> to(bytes, 0);
+    best = 1e30;
+    for (int rep = 0; rep < 5; rep++) {
+        const Clock::time_point start = Clock::now();
+        pool.parallelFor(threads, 0, [&](int t) {
+            const size_t begin = bytes * t / threads;
+            const size_t end = bytes * (t + 1) / threads;
+            memcpy(to.data() + begin, from.data() + begin, end - begin);
+        });
+        best = min(best, secondsSince(start));
+    }
+    peak.gbps = 2.0 * bytes / best * 1e-9;
+    return peak;
+}
+
+template <typename T>
+static BasicMatrix<T> randomMatrix(int n, mt19937& rng) {
+    BasicMatrix<T> m(n, n);
+    uniform_int_distribution<int> dist(-8, 8);
+    for (int i = 0; i < n; i++) {
+        T* row = m.data() + static_cast<size_t>(i) * m.stride();
+        for (int j = 0; j < n; j++) {
+            row[j] = static_cast<T>(dist(rng));
+        }
+    }
+    return m;
+}
+
+// Best of three batches; each batch repeats the call for at least minTime
+template <typename F>
+static double timeCall(double minTime, F call) {
+    double best = 1e30;
+    for (int batch = 0; batch < 3; batch++) {
+        long calls = 0;
+        const Clock::time_point start = Clock::now();
+        double elapsed = 0;
+        do {
+            call();
+            calls++;
+            elapsed = secondsSince(start);
+        } while (elapsed < minTime);
+        best = min(best, elapsed / calls);
+        if (elapsed > 10 * minTime) {
+            break; // one call already dwarfs the budget
+        }
+    }
+    return best * 1e9;
+}
+
+template <typename T>
+static vector<BenchmarkResult> runBenchmarks(const BenchmarkOptions& options, const MachinePeak& peak) {
+    typedef BasicMatrixOperations<T> Ops;
+    vector<BenchmarkResult> results;
+    mt19937 rng(42);
+    volatile bool sink = false;
+
+    for (int n = options.minSize; n <= options.maxSize; n *= 2) {
+        const BasicMatrix<T> a = randomMatrix<T>(n, rng);
+        const BasicMatrix<T> b = randomMatrix<T>(n, rng);
+        const BasicMatrix<T> c = a;
+        const double elements = static_cast<double>(n) * n;
+        const double size = sizeof(T);
+
+        for (const string& op : options.ops) {
+            double ns = 0;
+            double ops = elements;
+            double bytes = 0;
+            if (op == "add") {
+                ns = timeCall(options.minTime, [&] { Ops::add(a, b); });
+                bytes = 3 * elements * size;
+            } else if (op == "subtract") {
+                ns = timeCall(options.minTime, [&] { Ops::subtract(a, b); });
+                bytes = 3 * elements * size;
+            } else if (op == "scalarMultiply") {
+                ns = timeCall(options.minTime, [&] { Ops::scalarMultiply(a, T(3)); });
+                bytes = 2 * elements * size;
+            } else if (op == "multiply") {
+                if (n > options.maxMultiplySize) {
+                    continue;
+                }
+                ns = timeCall(options.minTime, [&] { Ops::multiply(a, b); });
+                ops = 2.0 * elements * n;
+                bytes = 3 * elements * size;
+            } else if (op == "transpose") {
+                ns = timeCall(options.minTime, [&] { Ops::transpose(a); });
+                ops = 0;
+                bytes = 2 * elements * size;
+            } else if (op == "isEqual") {
+                // Equal operands, so the whole matrix is compared
+                ns = timeCall(options.minTime, [&] { sink = Ops::isEqual(a, c); });
+                bytes = 2 * elements * size;
+            } else {
+                continue;
+            }
+
+            BenchmarkResult r;
+            r.op = op;
+            r.size = n;
+            r.nsPerOp = ns;
+            r.gops = ops / ns;
+            r.gbps = bytes / ns;
+            r.peak = op == "multiply" ? r.gops / peak.gops : r.gbps / peak.gbps;
+            results.push_back(r);
+            cerr << op << " " << n << ": " << ns << " ns\n";
+        }
+    }
+    (void)sink;
+    return results;
+}
+
+static void writeCsv(const BenchmarkOptions& options, const MachinePeak& peak,
+                     const vector<BenchmarkResult>& results) {
+    const char* simd = simdLevelName(SimdDispatch::level());
+    const int threads = ThreadPool::instance().size();
+    cout << "# peak_gops=" << peak.gops << " peak_gbps=" << peak.gbps << "\n";
+    cout << "label,type,simd,threads,op,size,ns_per_op,gops,gbps,peak\n";
+    for (const BenchmarkResult& r : results) {
+        cout << options.label << "," << options.type << "," << simd << "," << threads << ","
+             << r.op << "," << r.size << "," << r.nsPerOp << "," << r.gops << "," << r.gbps << ","
+             << r.peak << "\n";
+    }
+}
+
+static void writeJson(const BenchmarkOptions& options, const MachinePeak& peak,
+                      const vector<BenchmarkResult>& results) {
+    cout << "{\n";
+    cout << "  \"label\": \"" << options.label << "\",\n";
+    cout << "  \"type\": \"" << options.type << "\",\n";
+    cout << "  \"simd\": \"" << simdLevelName(SimdDispatch::level()) << "\",\n";
+    cout << "  \"threads\": " << ThreadPool::instance().size() << ",\n";
+    cout << "  \"peak\": { \"gops\": " << peak.gops << ", \"gbps\": " << peak.gbps << " },\n";
+    cout << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        cout << (i ? ",\n" : "\n") << "    { \"op\": \"" << r.op << "\", \"size\": " << r.size
+             << ", \"ns_per_op\": " << r.nsPerOp << ", \"gops\": " << r.gops
+             << ", \"gbps\": " << r.gbps << ", \"peak\": " << r.peak << " }";
+    }
+    cout << "\n  ]\n}\n";
+}
+
+template <typename T>
+static int run(const BenchmarkOptions& options) {
+    const MachinePeak peak = measurePeak<T>();
+    const vector<BenchmarkResult> results = runBenchmarks<T>(options, peak);
+    if (options.format == "json") {
+        writeJson(options, peak, results);
+    } else {
+        writeCsv(options, peak, results);
+    }
+    return 0;
+}
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [options]\n"
+         << "  --format csv|json         output format (csv)\n"
+         << "  --type int|float|double   element type (int)\n"
+         << "  --ops a,b,...             operations to run (all)\n"
+         << "  --min-size N              smallest size (4)\n"
+         << "  --max-size N              largest size (16384)\n"
+         << "  --max-multiply-size N     largest multiply size (4096)\n"
+         << "  --min-time S              seconds per measurement (0.2)\n"
+         << "  --label TEXT              tag copied into every row\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        const string value = argv[++i];
+        if (arg == "--format") {
+            options.format = value;
+        } else if (arg == "--type") {
+            options.type = value;
+        } else if (arg == "--label") {
+            options.label = value;
+        } else if (arg == "--ops") {
+            options.ops.clear();
+            stringstream list(value);
+            string op;
+            while (getline(list, op, ',')) {
+                options.ops.push_back(op);
+            }
+        } else if (arg == "--min-size") {
+            options.minSize = max(1, atoi(value.c_str()));
+        } else if (arg == "--max-size") {
+            options.maxSize = atoi(value.c_str());
+        } else if (arg == "--max-multiply-size") {
+            options.maxMultiplySize = atoi(value.c_str());
+        } else if (arg == "--min-time") {
+            options.minTime = atof(value.c_str());
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (options.type == "float") {
+        return run<float>(options);
+    }
+    if (options.type == "double") {
+        return run<double>(options);
+    }
+    if (options.type == "int") {
+        return run<int>(options);
+    }
+    printUsage(argv[0]);
+    return 2;
+}
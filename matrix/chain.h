@@ -0,0 +1,65 @@
+#ifndef MATRIX_CHAIN_H
+#define MATRIX_CHAIN_H
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+// MatrixChainPlan - cheapest parenthesization of a product A0 A1 ... An-1.
+//
+// Matrix i is dims[i] x dims[i + 1]. The classic O(n^3) dynamic program
+// over sub-chains finds the split minimizing scalar multiply-adds, which
+// for chains of differently shaped matrices can differ from left-to-right
+// evaluation by orders of magnitude.
+class MatrixChainPlan {
+private:
+    int count;
+    std::vector<long long> costs; // costs[i * count + j]: best for Ai..Aj
+    std::vector<int> splits;      // splits[i * count + j]: (Ai..Ak)(Ak+1..Aj)
+
+public:
+    explicit MatrixChainPlan(const std::vector<int>& dims)
+        : count(dims.size() > 1 ? static_cast<int>(dims.size()) - 1 : 0),
+          costs(static_cast<std::size_t>(count) * count, 0),
+          splits(static_cast<std::size_t>(count) * count, 0) {
+        for (int length = 2; length <= count; length++) {
+            for (int i = 0; i + length - 1 < count; i++) {
+                const int j = i + length - 1;
+                long long best = std::numeric_limits<long long>::max();
+                for (int k = i; k < j; k++) {
+                    const long long cost = costs[i * count + k] + costs[(k + 1) * count + j]
+                                           + static_cast<long long>(dims[i]) * dims[k + 1] * dims[j + 1];
+                    if (cost < best) {
+                        best = cost;
+                        splits[i * count + j] = k;
+                    }
+                }
+                costs[i * count + j] = best;
+            }
+        }
+    }
+
+    int size() const { return count; }
+
+    // Multiply-adds of the whole chain, or of Ai..Aj
+    long long cost() const { return count > 0 ? cost(0, count - 1) : 0; }
+    long long cost(int i, int j) const { return costs[i * count + j]; }
+
+    // Last index of the left factor when Ai..Aj (i < j) is split
+    int split(int i, int j) const { return splits[i * count + j]; }
+
+    // Parenthesized order, e.g. "((A0 A1) A2)"
+    std::string toString() const { return count > 0 ? toString(0, count - 1) : std::string(); }
+
+private:
+    std::string toString(int i, int j) const {
+        if (i == j) {
+            return "A" + std::to_string(i);
+        }
+        const int k = split(i, j);
+        return "(" + toString(i, k) + " " + toString(k + 1, j) + ")";
+    }
+};
+
+#endif // MATRIX_CHAIN_H
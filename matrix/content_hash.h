@@ -0,0 +1,100 @@
+#ifndef MATRIX_CONTENT_HASH_H
+#define MATRIX_CONTENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// ContentHash - 64-bit fingerprint of a matrix's elements.
+//
+// Four independent multiply-rotate lanes (the xxHash64 round) consume the
+// elements eight bytes at a time, so hashing runs at memory speed rather
+// than at the latency of one multiply per word. Only the rows x cols
+// elements take part, never the row padding, and the shape seeds the hash
+// so a 2x3 and a 3x2 matrix of the same values differ. Floating-point
+// zeros are hashed as +0.0: -0.0 compares equal to 0.0, and equal
+// matrices must hash alike. The result is never 0, which callers may use
+// to mean "not computed".
+class ContentHash {
+public:
+    template <typename T>
+    static std::uint64_t matrix(const T* data, int rows, int cols, std::ptrdiff_t stride) {
+        std::uint64_t hash = mix(PRIME5 + (static_cast<std::uint64_t>(rows) << 32) + static_cast<std::uint32_t>(cols));
+        for (int i = 0; i < rows; i++) {
+            hash = row(data + i * stride, cols, hash, std::is_floating_point<T>());
+        }
+        return hash != 0 ? hash : 1;
+    }
+
+private:
+    static constexpr std::uint64_t PRIME1 = 11400714785074694791ULL;
+    static constexpr std::uint64_t PRIME2 = 14029467366897019727ULL;
+    static constexpr std::uint64_t PRIME3 = 1609587929392839161ULL;
+    static constexpr std::uint64_t PRIME4 = 9650029242287828579ULL;
+    static constexpr std::uint64_t PRIME5 = 2870177450012600261ULL;
+
+    // Elements of a floating-point row are copied through a small buffer
+    // with negative zeros cleared
+    static constexpr int CHUNK = 256;
+
+    template <typename T>
+    static std::uint64_t row(const T* data, int cols, std::uint64_t hash, std::false_type) {
+        return bytes(reinterpret_cast<const unsigned char*>(data), static_cast<std::size_t>(cols) * sizeof(T), hash);
+    }
+
+    template <typename T>
+    static std::uint64_t row(const T* data, int cols, std::uint64_t hash, std::true_type) {
+        T chunk[CHUNK];
+        for (int j = 0; j < cols; j += CHUNK) {
+            const int count = cols - j < CHUNK ? cols - j : CHUNK;
+            for (int p = 0; p < count; p++) {
+                chunk[p] = data[j + p] == T(0) ? T(0) : data[j + p];
+            }
+            hash = bytes(reinterpret_cast<const unsigned char*>(chunk), static_cast<std::size_t>(count) * sizeof(T),
+                         hash);
+        }
+        return hash;
+    }
+
+    static std::uint64_t rotate(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static std::uint64_t round(std::uint64_t lane, std::uint64_t word) {
+        return rotate(lane + word * PRIME2, 31) * PRIME1;
+    }
+
+    static std::uint64_t mix(std::uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        return hash ^ (hash >> 32);
+    }
+
+    // Hash n bytes, continuing from hash
+    static std::uint64_t bytes(const unsigned char* p, std::size_t n, std::uint64_t hash) {
+        std::uint64_t lanes[4] = { hash + PRIME1 + PRIME2, hash + PRIME2, hash, hash - PRIME1 };
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            for (int k = 0; k < 4; k++) {
+                std::uint64_t word;
+                std::memcpy(&word, p + i + 8 * k, 8);
+                lanes[k] = round(lanes[k], word);
+            }
+        }
+        std::uint64_t result = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+        for (; i + 8 <= n; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p + i, 8);
+            result = rotate(result ^ round(0, word), 27) * PRIME1 + PRIME4;
+        }
+        if (i < n) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, p + i, n - i);
+            result = rotate(result ^ round(0, word), 27) * PRIME1 + PRIME4;
+        }
+        return mix(result + n);
+    }
+};
+
+#endif // MATRIX_CONTENT_HASH_H
@@ -0,0 +1,59 @@
+#ifndef MATRIX_ELEMENT_TRAITS_H
+#define MATRIX_ELEMENT_TRAITS_H
+
+#include <cstdint>
+#include <type_traits>
+
+// AccumulatorTraits - default type products are accumulated (and returned)
+// in. Narrow integers widen to 32 bits so int8 x int8 and int16 x int16
+// sums do not overflow after a handful of terms; everything else
+// accumulates in its own type.
+template <typename T>
+struct AccumulatorTraits {
+    typedef T type;
+};
+
+template <>
+struct AccumulatorTraits<std::int8_t> {
+    typedef std::int32_t type;
+};
+
+template <>
+struct AccumulatorTraits<std::uint8_t> {
+    typedef std::uint32_t type;
+};
+
+template <>
+struct AccumulatorTraits<std::int16_t> {
+    typedef std::int32_t type;
+};
+
+template <>
+struct AccumulatorTraits<std::uint16_t> {
+    typedef std::uint32_t type;
+};
+
+// StreamTraits - type used to read and print an element with iostreams, so
+// 8-bit integers show up as numbers rather than characters
+template <typename T>
+struct StreamTraits {
+    typedef typename std::conditional<std::is_integral<T>::value && sizeof(T) < sizeof(int),
+                                      int, T>::type type;
+};
+
+// RealTraits - floating-point type factorizations (LU, inverse, solve)
+// run in: floating-point elements keep their own type, integers promote to
+// double
+template <typename T>
+struct RealTraits {
+    typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type type;
+};
+
+// DeterminantTraits - type a determinant is returned in. Integer
+// determinants are computed exactly and returned as 64-bit integers.
+template <typename T>
+struct DeterminantTraits {
+    typedef typename std::conditional<std::is_integral<T>::value, long long, T>::type type;
+};
+
+#endif // MATRIX_ELEMENT_TRAITS_H
@@ -0,0 +1,149 @@
+#ifndef MATRIX_EXPRESSION_H
+#define MATRIX_EXPRESSION_H
+
+#include <iostream>
+#include <type_traits>
+
+template <typename T>
+class BasicMatrix;
+
+// Lazily evaluated elementwise matrix expressions.
+//
+// A + B - 3 * C builds a small tree of nodes instead of three temporary
+// matrices; the tree is evaluated in a single fused pass when it is assigned
+// to (or used to construct) a matrix. Every node reports its shape and
+// yields element (i, j) on demand as its value_type.
+template <typename E>
+class MatrixExpression {
+public:
+    const E& self() const { return static_cast<const E&>(*this); }
+
+    int getRows() const { return self().getRows(); }
+    int getCols() const { return self().getCols(); }
+    decltype(auto) operator()(int i, int j) const { return self()(i, j); }
+};
+
+// Matrices are held by reference inside a tree, nested nodes by value, so an
+// expression stored in a local variable never refers to a dead temporary
+template <typename E>
+struct ExpressionOperand {
+    typedef const E type;
+};
+
+template <typename T>
+struct ExpressionOperand<BasicMatrix<T>> {
+    typedef const BasicMatrix<T>& type;
+};
+
+// Shared shape check for binary nodes. A mismatch is reported once and the
+// node becomes 0x0, which evaluates to an empty matrix.
+inline bool expressionShapesMatch(const char* operation, int rows1, int cols1, int rows2, int cols2) {
+    if (rows1 == rows2 && cols1 == cols2) {
+        return true;
+    }
+    if (rows1 != 0 && rows2 != 0) {
+        std::cout << "Error: Matrices must have same dimensions for " << operation << "!\n";
+        std::cout << "Matrix 1: " << rows1 << "x" << cols1 << "\n";
+        std::cout << "Matrix 2: " << rows2 << "x" << cols2 << "\n";
+    }
+    return false;
+}
+
+// Node for L + R
+template <typename L, typename R>
+class MatrixSum : public MatrixExpression<MatrixSum<L, R>> {
+public:
+    typedef typename L::value_type value_type;
+    static_assert(std::is_same<value_type, typename R::value_type>::value,
+                  "operands of + must have the same element type");
+
+private:
+    typename ExpressionOperand<L>::type left;
+    typename ExpressionOperand<R>::type right;
+    int rows;
+    int cols;
+
+public:
+    MatrixSum(const L& l, const R& r) : left(l), right(r), rows(0), cols(0) {
+        if (expressionShapesMatch("addition", l.getRows(), l.getCols(), r.getRows(), r.getCols())) {
+            rows = l.getRows();
+            cols = l.getCols();
+        }
+    }
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    value_type operator()(int i, int j) const { return static_cast<value_type>(left(i, j) + right(i, j)); }
+};
+
+// Node for L - R
+template <typename L, typename R>
+class MatrixDifference : public MatrixExpression<MatrixDifference<L, R>> {
+public:
+    typedef typename L::value_type value_type;
+    static_assert(std::is_same<value_type, typename R::value_type>::value,
+                  "operands of - must have the same element type");
+
+private:
+    typename ExpressionOperand<L>::type left;
+    typename ExpressionOperand<R>::type right;
+    int rows;
+    int cols;
+
+public:
+    MatrixDifference(const L& l, const R& r) : left(l), right(r), rows(0), cols(0) {
+        if (expressionShapesMatch("subtraction", l.getRows(), l.getCols(), r.getRows(), r.getCols())) {
+            rows = l.getRows();
+            cols = l.getCols();
+        }
+    }
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    value_type operator()(int i, int j) const { return static_cast<value_type>(left(i, j) - right(i, j)); }
+};
+
+// Node for scalar * E
+template <typename E>
+class MatrixScaled : public MatrixExpression<MatrixScaled<E>> {
+public:
+    typedef typename E::value_type value_type;
+
+private:
+    typename ExpressionOperand<E>::type operand;
+    value_type scalar;
+
+public:
+    MatrixScaled(const E& e, value_type s) : operand(e), scalar(s) {}
+
+    int getRows() const { return operand.getRows(); }
+    int getCols() const { return operand.getCols(); }
+    value_type operator()(int i, int j) const { return static_cast<value_type>(operand(i, j) * scalar); }
+};
+
+template <typename L, typename R>
+inline MatrixSum<L, R> operator+(const MatrixExpression<L>& l, const MatrixExpression<R>& r) {
+    return MatrixSum<L, R>(l.self(), r.self());
+}
+
+template <typename L, typename R>
+inline MatrixDifference<L, R> operator-(const MatrixExpression<L>& l, const MatrixExpression<R>& r) {
+    return MatrixDifference<L, R>(l.self(), r.self());
+}
+
+template <typename S, typename E, typename = typename std::enable_if<std::is_arithmetic<S>::value>::type>
+inline MatrixScaled<E> operator*(S scalar, const MatrixExpression<E>& e) {
+    return MatrixScaled<E>(e.self(), static_cast<typename E::value_type>(scalar));
+}
+
+template <typename S, typename E, typename = typename std::enable_if<std::is_arithmetic<S>::value>::type>
+inline MatrixScaled<E> operator*(const MatrixExpression<E>& e, S scalar) {
+    return MatrixScaled<E>(e.self(), static_cast<typename E::value_type>(scalar));
+}
+
+template <typename E>
+inline MatrixScaled<E> operator-(const MatrixExpression<E>& e) {
+    return MatrixScaled<E>(e.self(), static_cast<typename E::value_type>(-1));
+}
+
+#endif // MATRIX_EXPRESSION_H
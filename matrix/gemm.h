@@ -0,0 +1,502 @@
+#ifndef MATRIX_GEMM_H
+#define MATRIX_GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <new>
+
+#include "simd.h"
+#include "thread_pool.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+// CacheInfo - data cache sizes used to pick GEMM block sizes
+struct CacheInfo {
+    std::size_t l1;
+    std::size_t l2;
+    std::size_t l3;
+
+    // Detected once; falls back to common desktop sizes when the OS does
+    // not report a level
+    static const CacheInfo& detect() {
+        static const CacheInfo info = query();
+        return info;
+    }
+
+private:
+    static CacheInfo query() {
+        CacheInfo info = { 32 * 1024, 256 * 1024, 8 * 1024 * 1024 };
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+        long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (l1 > 0) info.l1 = static_cast<std::size_t>(l1);
+        if (l2 > 0) info.l2 = static_cast<std::size_t>(l2);
+        if (l3 > 0) info.l3 = static_cast<std::size_t>(l3);
+#endif
+        if (info.l2 < info.l1) info.l2 = info.l1 * 8;
+        if (info.l3 < info.l2) info.l3 = info.l2 * 4;
+        return info;
+    }
+};
+
+// AlignedBuffer - owning, cache-line aligned scratch array
+template <typename T>
+class AlignedBuffer {
+private:
+    T* buffer;
+    std::size_t count;
+
+public:
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    explicit AlignedBuffer(std::size_t n = 0) : buffer(nullptr), count(0) {
+        resize(n);
+    }
+
+    ~AlignedBuffer() {
+        if (buffer != nullptr) {
+            ::operator delete(buffer, std::align_val_t(ALIGNMENT));
+        }
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    // Grow to at least n elements; contents are not preserved
+    void resize(std::size_t n) {
+        if (n <= count) {
+            return;
+        }
+        if (buffer != nullptr) {
+            ::operator delete(buffer, std::align_val_t(ALIGNMENT));
+        }
+        buffer = static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT)));
+        count = n;
+    }
+
+    T* get() { return buffer; }
+    std::size_t size() const { return count; }
+};
+
+// GemmMicroLoops - body of the MR x NR register-tiled micro-kernel for one
+// vector width. Each step of k broadcasts MR values of the packed A panel
+// against one NR-wide row of the packed B panel; the MR x NR accumulator
+// tile lives in vector registers for the whole panel and is written to out
+// (MR rows of NR) at the end. Force-inlined into the per-ISA wrappers below.
+#if defined(MATRIX_SIMD_X86)
+template <typename Acc, int MR, int NR, int Bytes>
+struct GemmMicroLoops {
+    typedef Acc Vec __attribute__((vector_size(Bytes)));
+    static constexpr int LANES = Bytes / sizeof(Acc);
+    static constexpr int V = NR / LANES;
+
+    static MATRIX_ALWAYS_INLINE void run(int kc, const Acc* a, const Acc* b, Acc* out) {
+        Vec acc[MR][V];
+#pragma GCC unroll 16
+        for (int i = 0; i < MR; i++) {
+#pragma GCC unroll 16
+            for (int v = 0; v < V; v++) {
+                acc[i][v] = Vec{};
+            }
+        }
+        for (int p = 0; p < kc; p++) {
+            Vec bv[V];
+#pragma GCC unroll 16
+            for (int v = 0; v < V; v++) {
+                std::memcpy(&bv[v], b + v * LANES, sizeof(Vec));
+            }
+#pragma GCC unroll 16
+            for (int i = 0; i < MR; i++) {
+                const Vec ai = Vec{} + a[i];
+#pragma GCC unroll 16
+                for (int v = 0; v < V; v++) {
+                    acc[i][v] += ai * bv[v];
+                }
+            }
+            a += MR;
+            b += NR;
+        }
+        for (int i = 0; i < MR; i++) {
+            for (int v = 0; v < V; v++) {
+                std::memcpy(out + i * NR + v * LANES, &acc[i][v], sizeof(Vec));
+            }
+        }
+    }
+};
+
+// Floating-point accumulators contract to FMA under the avx2,fma and
+// avx512f targets when -ffp-contract=fast is in effect (GCC's default in
+// its GNU dialects)
+#define MATRIX_DEFINE_GEMM_MICRO_KERNEL(Name, isa, bytes)                              \
+    template <typename Acc, int MR, int NR>                                             \
+    struct Name {                                                                       \
+        MATRIX_TARGET(isa) static void run(int kc, const Acc* a, const Acc* b,          \
+                                           Acc* out) {                                  \
+            GemmMicroLoops<Acc, MR, NR, bytes>::run(kc, a, b, out);                     \
+        }                                                                               \
+    };
+
+MATRIX_DEFINE_GEMM_MICRO_KERNEL(Sse42GemmMicroKernel, "sse4.2", 16)
+MATRIX_DEFINE_GEMM_MICRO_KERNEL(Avx2GemmMicroKernel, "avx2,fma", 32)
+MATRIX_DEFINE_GEMM_MICRO_KERNEL(Avx512GemmMicroKernel, "avx512f,avx512bw", 64)
+#endif
+
+// Portable micro-kernel with the same contract as GemmMicroLoops
+template <typename Acc, int MR, int NR>
+struct ScalarGemmMicroKernel {
+    static void run(int kc, const Acc* a, const Acc* b, Acc* out) {
+        Acc acc[MR][NR] = {};
+        for (int p = 0; p < kc; p++) {
+            for (int i = 0; i < MR; i++) {
+                const Acc ai = a[i];
+                for (int j = 0; j < NR; j++) {
+                    acc[i][j] += ai * b[j];
+                }
+            }
+            a += MR;
+            b += NR;
+        }
+        for (int i = 0; i < MR; i++) {
+            for (int j = 0; j < NR; j++) {
+                out[i * NR + j] = acc[i][j];
+            }
+        }
+    }
+};
+
+// GemmKernel - packed, cache-blocked matrix product in the style of
+// GotoBLAS/BLIS.
+//
+// The five loops around the micro-kernel block n by NC (B block resident in
+// L3), k by KC (A micro-panel plus B micro-panel resident in L1) and m by MC
+// (A block resident in L2). Blocks of A and B are copied into contiguous
+// micro-panels of MR rows / NR columns so the micro-kernel reads both with
+// unit stride regardless of the operands' layout, and keeps an MR x NR tile
+// of C in registers for the whole KC loop.
+//
+// Operands are described by a base pointer plus row and column strides, so
+// any row-major, column-major or strided sub-block can be passed directly.
+// Elements of type T are widened to the accumulator type Acc while packing,
+// so e.g. int16 x int16 products accumulate (and land in C) as int32. The
+// micro-kernel is picked once per Acc from the SIMD level in SimdDispatch.
+template <typename T, typename Acc = T>
+class GemmKernel {
+public:
+    static constexpr int MR = 6;
+    static constexpr int NR = static_cast<int>(64 / sizeof(Acc)) < 8 ? 8 : static_cast<int>(64 / sizeof(Acc));
+
+    // Products below this many multiply-adds skip packing entirely
+    static constexpr long long SMALL_PRODUCT = 32 * 32 * 32;
+
+    // Products below this many multiply-adds run on the calling thread
+    static constexpr long long PARALLEL_THRESHOLD = 128LL * 128 * 128;
+
+    // Output tiles multiplyParallel aims for by default, enough to keep
+    // typical pools busy; fixed so the tiling follows the shape alone
+    static constexpr int PARALLEL_TILES = 64;
+
+    struct BlockSizes {
+        int mc;
+        int nc;
+        int kc;
+    };
+
+    typedef void (*MicroKernel)(int, const Acc*, const Acc*, Acc*);
+
+    // Block sizes derived from the detected cache hierarchy: each level is
+    // filled to about half so the streamed operand does not evict the
+    // resident one
+    static const BlockSizes& blockSizes() {
+        static const BlockSizes sizes = computeBlockSizes(CacheInfo::detect());
+        return sizes;
+    }
+
+    static MicroKernel microKernel() {
+        static const MicroKernel selected = selectMicroKernel(SimdDispatch::level());
+        return selected;
+    }
+
+    // C (m x n, row stride ldc) = A (m x k) * B (k x n)
+    static void multiply(int m, int n, int k,
+                         const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                         const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                         Acc* c, std::ptrdiff_t ldc) {
+        multiply(m, n, k, Acc(1), a, rsa, csa, b, rsb, csb, Acc(0), c, ldc);
+    }
+
+    // C = alpha * A * B + beta * C. The scaling is applied where each tile
+    // of the product is stored, so accumulating into C costs no extra pass;
+    // with beta == 0 the old contents of C are never read.
+    static void multiply(int m, int n, int k, Acc alpha,
+                         const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                         const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                         Acc beta, Acc* c, std::ptrdiff_t ldc) {
+        if (m <= 0 || n <= 0) {
+            return;
+        }
+        if (k <= 0 || alpha == Acc(0)) {
+            for (int i = 0; i < m; i++) {
+                scaleRow(c + i * ldc, n, beta);
+            }
+            return;
+        }
+        if (static_cast<long long>(m) * n * k <= SMALL_PRODUCT) {
+            multiplySmall(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, ldc);
+            return;
+        }
+        multiplyPacked(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, ldc);
+    }
+
+    // Same product split into square output tiles of about grain x grain
+    // (0 picks a size from the shape alone) that the pool's threads steal
+    // from each other. Every tile takes the packed path whatever its size
+    // and runs the full k loop in the same blocked order, and an element's
+    // sums depend only on the kc blocking, so the result is bit-identical to
+    // multiply() for any thread count and any tiling.
+    static void multiplyParallel(int m, int n, int k,
+                                 const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                                 const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                                 Acc* c, std::ptrdiff_t ldc, int threads, int grain) {
+        multiplyParallel(m, n, k, Acc(1), a, rsa, csa, b, rsb, csb, Acc(0), c, ldc, threads, grain);
+    }
+
+    static void multiplyParallel(int m, int n, int k, Acc alpha,
+                                 const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                                 const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                                 Acc beta, Acc* c, std::ptrdiff_t ldc, int threads, int grain) {
+        const int available = plannedThreads(m, n, k, threads);
+        if (available == 1) {
+            multiply(m, n, k, alpha, a, rsa, csa, b, rsb, csb, beta, c, ldc);
+            return;
+        }
+        ThreadPool& pool = ThreadPool::instance();
+
+        int tile = grain;
+        if (tile <= 0) {
+            double perTile = static_cast<double>(m) * n / PARALLEL_TILES;
+            tile = std::max(64, static_cast<int>(std::sqrt(perTile)));
+        }
+        tile = (tile + NR - 1) / NR * NR;
+
+        const int tileRows = (m + tile - 1) / tile;
+        const int tileCols = (n + tile - 1) / tile;
+        pool.parallelFor(tileRows * tileCols, available, [=](int t) {
+            const int i0 = (t / tileCols) * tile;
+            const int j0 = (t % tileCols) * tile;
+            multiplyPacked(std::min(tile, m - i0), std::min(tile, n - j0), k, alpha,
+                           a + i0 * rsa, rsa, csa,
+                           b + j0 * csb, rsb, csb,
+                           beta, c + i0 * ldc + j0, ldc);
+        });
+    }
+
+    // Packing buffer elements one call (or one parallel tile) of an
+    // m x n x k product allocates; block sizes cap it for large products
+    static std::size_t workspaceElements(int m, int n, int k) {
+        const BlockSizes& bs = blockSizes();
+        const std::size_t kc = static_cast<std::size_t>(std::min(bs.kc, k));
+        return kc * (roundUp(std::min(bs.mc, m), MR) + roundUp(std::min(bs.nc, n), NR));
+    }
+
+    // Threads multiplyParallel runs an m x n x k product on. Small products
+    // are settled before touching the pool so they never start it.
+    static int plannedThreads(int m, int n, int k, int threads) {
+        if (threads == 1 || static_cast<long long>(m) * n * k < PARALLEL_THRESHOLD) {
+            return 1;
+        }
+        const int size = ThreadPool::instance().size();
+        return threads > 0 ? std::min(threads, size) : size;
+    }
+
+private:
+    // The blocked loops of multiply(), for every product size; k > 0 and
+    // alpha != 0 are handled here too so parallel tiles can call it directly
+    static void multiplyPacked(int m, int n, int k, Acc alpha,
+                               const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                               const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                               Acc beta, Acc* c, std::ptrdiff_t ldc) {
+        if (m <= 0 || n <= 0) {
+            return;
+        }
+        if (k <= 0 || alpha == Acc(0)) {
+            for (int i = 0; i < m; i++) {
+                scaleRow(c + i * ldc, n, beta);
+            }
+            return;
+        }
+
+        const BlockSizes& bs = blockSizes();
+        const int kcMax = std::min(bs.kc, k);
+        AlignedBuffer<Acc> packedA(static_cast<std::size_t>(roundUp(std::min(bs.mc, m), MR)) * kcMax);
+        AlignedBuffer<Acc> packedB(static_cast<std::size_t>(kcMax) * roundUp(std::min(bs.nc, n), NR));
+        const MicroKernel kernel = microKernel();
+
+        for (int jc = 0; jc < n; jc += bs.nc) {
+            const int nc = std::min(bs.nc, n - jc);
+            for (int pc = 0; pc < k; pc += bs.kc) {
+                const int kc = std::min(bs.kc, k - pc);
+                packB(kc, nc, b + pc * rsb + jc * csb, rsb, csb, packedB.get());
+                for (int ic = 0; ic < m; ic += bs.mc) {
+                    const int mc = std::min(bs.mc, m - ic);
+                    packA(mc, kc, a + ic * rsa + pc * csa, rsa, csa, packedA.get());
+                    macroKernel(kernel, mc, nc, kc, packedA.get(), packedB.get(),
+                                c + ic * ldc + jc, ldc, alpha, pc == 0 ? beta : Acc(1));
+                }
+            }
+        }
+    }
+
+    static int roundUp(int x, int multiple) {
+        return (x + multiple - 1) / multiple * multiple;
+    }
+
+    static BlockSizes computeBlockSizes(const CacheInfo& cache) {
+        BlockSizes bs;
+        const std::size_t elem = sizeof(Acc);
+
+        std::size_t kc = cache.l1 / 2 / ((MR + NR) * elem);
+        kc = std::max<std::size_t>(64, std::min<std::size_t>(1024, kc / 8 * 8));
+
+        std::size_t mc = cache.l2 / 2 / (kc * elem);
+        mc = std::max<std::size_t>(MR, std::min<std::size_t>(1024, mc / MR * MR));
+
+        std::size_t nc = cache.l3 / 2 / (kc * elem);
+        nc = std::max<std::size_t>(NR, std::min<std::size_t>(8192, nc / NR * NR));
+
+        bs.mc = static_cast<int>(mc);
+        bs.nc = static_cast<int>(nc);
+        bs.kc = static_cast<int>(kc);
+        return bs;
+    }
+
+    static MicroKernel selectMicroKernel(SimdLevel level) {
+#if defined(MATRIX_SIMD_X86)
+        switch (level) {
+            case SimdLevel::Avx512: return &Avx512GemmMicroKernel<Acc, MR, NR>::run;
+            case SimdLevel::Avx2:   return &Avx2GemmMicroKernel<Acc, MR, NR>::run;
+            case SimdLevel::Sse42:  return &Sse42GemmMicroKernel<Acc, MR, NR>::run;
+            default:                break;
+        }
+#else
+        (void)level;
+#endif
+        return &ScalarGemmMicroKernel<Acc, MR, NR>::run;
+    }
+
+    // row = beta * row, where beta == 0 clears without reading
+    static void scaleRow(Acc* row, int n, Acc beta) {
+        if (beta == Acc(0)) {
+            std::fill(row, row + n, Acc());
+        } else if (beta != Acc(1)) {
+            for (int j = 0; j < n; j++) {
+                row[j] *= beta;
+            }
+        }
+    }
+
+    // Unpacked i-k-j loop for products too small to amortize packing
+    static void multiplySmall(int m, int n, int k, Acc alpha,
+                              const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa,
+                              const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb,
+                              Acc beta, Acc* c, std::ptrdiff_t ldc) {
+        for (int i = 0; i < m; i++) {
+            Acc* ci = c + i * ldc;
+            scaleRow(ci, n, beta);
+            for (int p = 0; p < k; p++) {
+                const Acc aip = alpha * static_cast<Acc>(a[i * rsa + p * csa]);
+                const T* bp = b + p * rsb;
+                for (int j = 0; j < n; j++) {
+                    ci[j] += aip * static_cast<Acc>(bp[j * csb]);
+                }
+            }
+        }
+    }
+
+    // Copy an mc x kc block of A into row micro-panels: panel r holds rows
+    // r*MR .. r*MR+MR-1, stored column by column. Short panels are zero padded.
+    static void packA(int mc, int kc, const T* a, std::ptrdiff_t rsa, std::ptrdiff_t csa, Acc* dst) {
+        for (int ir = 0; ir < mc; ir += MR) {
+            const int mr = std::min(MR, mc - ir);
+            for (int p = 0; p < kc; p++) {
+                const T* src = a + ir * rsa + p * csa;
+                int i = 0;
+                for (; i < mr; i++) {
+                    dst[i] = static_cast<Acc>(src[i * rsa]);
+                }
+                for (; i < MR; i++) {
+                    dst[i] = Acc();
+                }
+                dst += MR;
+            }
+        }
+    }
+
+    // Copy a kc x nc block of B into column micro-panels of NR columns,
+    // stored row by row. Short panels are zero padded.
+    static void packB(int kc, int nc, const T* b, std::ptrdiff_t rsb, std::ptrdiff_t csb, Acc* dst) {
+        for (int jr = 0; jr < nc; jr += NR) {
+            const int nr = std::min(NR, nc - jr);
+            for (int p = 0; p < kc; p++) {
+                const T* src = b + p * rsb + jr * csb;
+                int j = 0;
+                if (csb == 1) {
+                    for (; j < nr; j++) {
+                        dst[j] = static_cast<Acc>(src[j]);
+                    }
+                } else {
+                    for (; j < nr; j++) {
+                        dst[j] = static_cast<Acc>(src[j * csb]);
+                    }
+                }
+                for (; j < NR; j++) {
+                    dst[j] = Acc();
+                }
+                dst += NR;
+            }
+        }
+    }
+
+    // Store each tile as C = alpha * tile + beta * C; the first k block
+    // passes the caller's beta, later ones 1
+    static void macroKernel(MicroKernel kernel, int mc, int nc, int kc,
+                            const Acc* packedA, const Acc* packedB,
+                            Acc* c, std::ptrdiff_t ldc, Acc alpha, Acc beta) {
+        alignas(64) Acc tile[MR * NR];
+        for (int jr = 0; jr < nc; jr += NR) {
+            const int nr = std::min(NR, nc - jr);
+            for (int ir = 0; ir < mc; ir += MR) {
+                const int mr = std::min(MR, mc - ir);
+                kernel(kc, packedA + ir * kc, packedB + jr * kc, tile);
+
+                for (int i = 0; i < mr; i++) {
+                    Acc* ci = c + (ir + i) * ldc + jr;
+                    const Acc* ti = tile + i * NR;
+                    if (alpha == Acc(1) && beta == Acc(0)) {
+                        for (int j = 0; j < nr; j++) {
+                            ci[j] = ti[j];
+                        }
+                    } else if (alpha == Acc(1) && beta == Acc(1)) {
+                        for (int j = 0; j < nr; j++) {
+                            ci[j] += ti[j];
+                        }
+                    } else if (beta == Acc(0)) {
+                        for (int j = 0; j < nr; j++) {
+                            ci[j] = alpha * ti[j];
+                        }
+                    } else {
+                        for (int j = 0; j < nr; j++) {
+                            ci[j] = alpha * ti[j] + beta * ci[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+#endif // MATRIX_GEMM_H
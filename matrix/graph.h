@@ -0,0 +1,298 @@
+#ifndef MATRIX_GRAPH_H
+#define MATRIX_GRAPH_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+#include "utility.h"
+
+// MatrixGraph - asynchronous evaluation of a DAG of matrix operations.
+//
+// Operations are recorded first, each returning a Task handle that later
+// operations take as input; nothing is computed until run(). From then on
+// every node whose inputs are ready is handed to the shared ThreadPool, so
+// independent operations (two unrelated products and a transpose, say)
+// overlap instead of running one after another. A parallel kernel inside a
+// node still spreads over the pool, which lets whichever is left running
+// use the idle threads.
+//
+// A computed matrix is dropped as soon as the last node reading it has
+// finished, so intermediates live only as long as they are needed.
+// Results are collected through future(), which must be requested before
+// run(); the graph keeps nothing else once it is done.
+//
+// A kernel that throws fails its node: the exception is delivered through
+// the node's future and through those of every node depending on it,
+// whose kernels are skipped, while the rest of the graph runs as usual.
+//
+// Products accumulate in T (BasicMatrixOperations<T, T>). A graph runs
+// once; destroying it waits for any work still in flight.
+template <typename T>
+class MatrixGraph {
+public:
+    typedef BasicMatrix<T> Matrix;
+    typedef BasicMatrixOperations<T, T> Operations;
+    typedef std::shared_ptr<const Matrix> Value;
+    typedef std::function<Matrix(const std::vector<const Matrix*>&)> Kernel;
+
+    struct Task {
+        int id;
+    };
+
+    MatrixGraph() : started(false), unfinished(0), liveBytes(0), peakLiveBytes(0) {}
+
+    MatrixGraph(const MatrixGraph&) = delete;
+    MatrixGraph& operator=(const MatrixGraph&) = delete;
+
+    ~MatrixGraph() {
+        wait();
+    }
+
+    // A matrix the graph reads in place; it must outlive run() and wait()
+    Task input(const Matrix& matrix1) {
+        return addInput(Value(&matrix1, [](const Matrix*) {}));
+    }
+
+    // A matrix handed over to the graph, released after its last use
+    Task input(Matrix&& matrix1) {
+        return addInput(std::make_shared<const Matrix>(std::move(matrix1)));
+    }
+
+    Task add(Task a, Task b) {
+        return apply({a, b}, [](const std::vector<const Matrix*>& in) { return Operations::add(*in[0], *in[1]); });
+    }
+
+    Task subtract(Task a, Task b) {
+        return apply({a, b},
+                     [](const std::vector<const Matrix*>& in) { return Operations::subtract(*in[0], *in[1]); });
+    }
+
+    Task multiply(Task a, Task b) {
+        return apply({a, b},
+                     [](const std::vector<const Matrix*>& in) { return Operations::multiply(*in[0], *in[1]); });
+    }
+
+    Task scalarMultiply(Task a, T scalar) {
+        return apply({a}, [scalar](const std::vector<const Matrix*>& in) {
+            return Operations::scalarMultiply(*in[0], scalar);
+        });
+    }
+
+    Task transpose(Task a) {
+        return apply({a}, [](const std::vector<const Matrix*>& in) { return Operations::transpose(*in[0]); });
+    }
+
+    Task power(Task a, int exponent) {
+        return apply({a}, [exponent](const std::vector<const Matrix*>& in) {
+            return Operations::power(*in[0], exponent);
+        });
+    }
+
+    // Any other operation: kernel receives the inputs' values in order
+    Task apply(const std::vector<Task>& inputs, Kernel kernel) {
+        if (!checkBuilding("add an operation to")) {
+            return Task{-1};
+        }
+        std::unique_ptr<Node> node(new Node());
+        node->kernel = std::move(kernel);
+        for (const Task& in : inputs) {
+            if (in.id < 0 || in.id >= static_cast<int>(nodes.size())) {
+                std::cout << "Error: Invalid task passed to a matrix graph!\n";
+                return Task{-1};
+            }
+            node->inputs.push_back(in.id);
+        }
+        const int id = static_cast<int>(nodes.size());
+        for (int in : node->inputs) {
+            nodes[in]->consumers.push_back(id);
+        }
+        nodes.push_back(std::move(node));
+        return Task{id};
+    }
+
+    // Result of a task, available once it has run
+    std::shared_future<Value> future(Task task) {
+        if (!checkBuilding("request a result from") || task.id < 0 || task.id >= static_cast<int>(nodes.size())) {
+            return std::shared_future<Value>();
+        }
+        Node& node = *nodes[task.id];
+        if (!node.output) {
+            node.output = true;
+            node.result = node.promise.get_future().share();
+        }
+        return node.result;
+    }
+
+    // Start every operation whose inputs are ready and return
+    void run() {
+        std::vector<int> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (started) {
+                std::cout << "Error: Matrix graph is already running!\n";
+                return;
+            }
+            started = true;
+            for (std::size_t id = 0; id < nodes.size(); id++) {
+                Node& node = *nodes[id];
+                node.pendingUses = static_cast<int>(node.consumers.size());
+                if (node.value) {
+                    // Inputs are complete from the start
+                    if (node.output) {
+                        node.promise.set_value(node.value);
+                    }
+                    if (node.pendingUses == 0) {
+                        node.value.reset();
+                    }
+                    continue;
+                }
+                unfinished++;
+                node.waiting = 0;
+                for (int in : node.inputs) {
+                    node.waiting += nodes[in]->kernel ? 1 : 0;
+                }
+                if (node.waiting == 0) {
+                    ready.push_back(static_cast<int>(id));
+                }
+            }
+        }
+        schedule(ready);
+    }
+
+    // Block until every operation has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return unfinished == 0; });
+    }
+
+    // Most bytes of computed results the graph held at once
+    std::size_t peakBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peakLiveBytes;
+    }
+
+private:
+    struct Node {
+        Kernel kernel;              // empty for inputs
+        std::vector<int> inputs;
+        std::vector<int> consumers;
+        int waiting = 0;            // inputs still being computed
+        int pendingUses = 0;        // consumers not yet finished
+        bool output = false;
+        Value value;
+        std::exception_ptr error;   // set when the node failed
+        std::promise<Value> promise;
+        std::shared_future<Value> result;
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    mutable std::mutex mutex;
+    std::condition_variable done;
+    bool started;
+    int unfinished;
+    std::size_t liveBytes;
+    std::size_t peakLiveBytes;
+
+    Task addInput(Value value) {
+        if (!checkBuilding("add an input to")) {
+            return Task{-1};
+        }
+        std::unique_ptr<Node> node(new Node());
+        node->value = std::move(value);
+        nodes.push_back(std::move(node));
+        return Task{static_cast<int>(nodes.size()) - 1};
+    }
+
+    bool checkBuilding(const char* action) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (started) {
+            std::cout << "Error: Cannot " << action << " a matrix graph that has been run!\n";
+            return false;
+        }
+        return true;
+    }
+
+    static std::size_t bytesOf(const Matrix& matrix1) {
+        return static_cast<std::size_t>(matrix1.getRows()) * matrix1.stride() * sizeof(T);
+    }
+
+    void schedule(const std::vector<int>& ready) {
+        for (int id : ready) {
+            ThreadPool::instance().submit([this, id] { execute(id); });
+        }
+    }
+
+    void execute(int id) {
+        Node& node = *nodes[id];
+        std::vector<const Matrix*> arguments;
+        arguments.reserve(node.inputs.size());
+        std::exception_ptr error;
+        for (int in : node.inputs) {
+            arguments.push_back(nodes[in]->value.get());
+            if (!error) {
+                error = nodes[in]->error;
+            }
+        }
+        Value value;
+        if (!error) {
+            try {
+                value = std::make_shared<const Matrix>(node.kernel(arguments));
+            } catch (...) {
+                error = std::current_exception();
+            }
+        }
+
+        std::vector<int> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (node.output) {
+                if (error) {
+                    node.promise.set_exception(error);
+                } else {
+                    node.promise.set_value(value);
+                }
+            }
+            if (node.pendingUses > 0) {
+                if (error) {
+                    node.error = error;
+                } else {
+                    node.value = value;
+                    liveBytes += bytesOf(*value);
+                    peakLiveBytes = std::max(peakLiveBytes, liveBytes);
+                }
+            }
+            for (int in : node.inputs) {
+                Node& input = *nodes[in];
+                if (--input.pendingUses == 0 && input.value) {
+                    if (input.kernel) {
+                        liveBytes -= bytesOf(*input.value);
+                    }
+                    input.value.reset();
+                }
+            }
+            for (int consumer : node.consumers) {
+                if (--nodes[consumer]->waiting == 0) {
+                    ready.push_back(consumer);
+                }
+            }
+        }
+        schedule(ready);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--unfinished == 0) {
+            done.notify_all();
+        }
+    }
+};
+
+#endif // MATRIX_GRAPH_H
@@ -0,0 +1,293 @@
+#ifndef MATRIX_INSTRUMENTATION_H
+#define MATRIX_INSTRUMENTATION_H
+
+// Opt-in profiling of matrix operations.
+//
+// Built with MATRIX_ENABLE_INSTRUMENTATION defined, every MatrixOperations
+// entry point opens a MATRIX_INSTRUMENT scope that records its wall time,
+// the element operations and bytes it touched, the matrix buffers
+// allocated while it ran, and the kernel and thread count it chose.
+// MatrixInstrumentation::instance() aggregates these per operation
+// (snapshotJson()) and, while tracing, keeps one event per call for
+// writeTrace() in Chrome trace format (load it in chrome://tracing or
+// Perfetto). Nested operations are recorded separately, each with
+// inclusive time, and show up nested in the trace.
+//
+// Without the macro every MATRIX_INSTRUMENT* expands to nothing and its
+// arguments are never evaluated.
+
+#ifdef MATRIX_ENABLE_INSTRUMENTATION
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "simd.h"
+
+// Totals for one operation name
+struct MatrixOperationStats {
+    unsigned long long calls = 0;
+    unsigned long long nanoseconds = 0;
+    unsigned long long maxNanoseconds = 0;
+    unsigned long long elementOps = 0;
+    unsigned long long bytes = 0;
+    unsigned long long allocations = 0;
+    unsigned long long allocatedBytes = 0;
+    int maxThreads = 0;
+    std::map<std::string, unsigned long long> kernels; // calls per kernel
+};
+
+// What one call did, as filled in by MatrixInstrumentationScope
+struct MatrixOperationRecord {
+    const char* operation;
+    long long startNanoseconds; // since the instrumentation started
+    long long nanoseconds;
+    unsigned long long elementOps;
+    unsigned long long bytes;
+    unsigned long long allocations;
+    unsigned long long allocatedBytes;
+    const char* kernel; // may be null
+    const char* isa;    // may be null
+    int threads;
+    int thread;         // small id of the calling thread
+};
+
+class MatrixInstrumentation {
+public:
+    // Trace events kept at most; later calls still count in the totals
+    static constexpr std::size_t MAX_TRACE_EVENTS = std::size_t(1) << 20;
+
+    static MatrixInstrumentation& instance() {
+        static MatrixInstrumentation instrumentation;
+        return instrumentation;
+    }
+
+    long long now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin)
+            .count();
+    }
+
+    void record(const MatrixOperationRecord& call) {
+        std::lock_guard<std::mutex> lock(mutex);
+        MatrixOperationStats& stats = totals[call.operation];
+        stats.calls++;
+        stats.nanoseconds += call.nanoseconds;
+        if (static_cast<unsigned long long>(call.nanoseconds) > stats.maxNanoseconds) {
+            stats.maxNanoseconds = call.nanoseconds;
+        }
+        stats.elementOps += call.elementOps;
+        stats.bytes += call.bytes;
+        stats.allocations += call.allocations;
+        stats.allocatedBytes += call.allocatedBytes;
+        if (call.threads > stats.maxThreads) {
+            stats.maxThreads = call.threads;
+        }
+        if (call.kernel != nullptr) {
+            stats.kernels[kernelName(call)]++;
+        }
+        if (tracing.load(std::memory_order_relaxed)) {
+            if (events.size() < MAX_TRACE_EVENTS) {
+                events.push_back(call);
+            } else {
+                droppedEvents++;
+            }
+        }
+    }
+
+    std::map<std::string, MatrixOperationStats> snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totals;
+    }
+
+    // {"operations": {"<name>": {"calls": ..., ...}, ...}}
+    std::string snapshotJson() const {
+        const std::map<std::string, MatrixOperationStats> current = snapshot();
+        std::string json = "{\"operations\": {";
+        bool first = true;
+        for (const auto& entry : current) {
+            const MatrixOperationStats& stats = entry.second;
+            json += first ? "\n" : ",\n";
+            first = false;
+            json += "  \"" + entry.first + "\": {\"calls\": " + std::to_string(stats.calls)
+                    + ", \"total_ns\": " + std::to_string(stats.nanoseconds)
+                    + ", \"max_ns\": " + std::to_string(stats.maxNanoseconds)
+                    + ", \"element_ops\": " + std::to_string(stats.elementOps)
+                    + ", \"bytes\": " + std::to_string(stats.bytes)
+                    + ", \"allocations\": " + std::to_string(stats.allocations)
+                    + ", \"allocated_bytes\": " + std::to_string(stats.allocatedBytes)
+                    + ", \"max_threads\": " + std::to_string(stats.maxThreads) + ", \"kernels\": {";
+            bool firstKernel = true;
+            for (const auto& kernel : stats.kernels) {
+                json += (firstKernel ? "\"" : ", \"") + kernel.first + "\": " + std::to_string(kernel.second);
+                firstKernel = false;
+            }
+            json += "}}";
+        }
+        json += first ? "}}\n" : "\n}}\n";
+        return json;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        totals.clear();
+        events.clear();
+        droppedEvents = 0;
+    }
+
+    // Start keeping per-call events (discarding any from before)
+    void startTrace() {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+        droppedEvents = 0;
+        tracing.store(true, std::memory_order_relaxed);
+    }
+
+    // Stop tracing and write the events as a Chrome trace to path
+    bool writeTrace(const std::string& path) {
+        std::vector<MatrixOperationRecord> trace;
+        unsigned long long dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tracing.store(false, std::memory_order_relaxed);
+            trace.swap(events);
+            dropped = droppedEvents;
+        }
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            std::cout << "Error: Cannot write trace to " << path << "!\n";
+            return false;
+        }
+        std::fprintf(file, "{\"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped_events\": %llu},\n"
+                           "\"traceEvents\": [",
+                     dropped);
+        for (std::size_t i = 0; i < trace.size(); i++) {
+            const MatrixOperationRecord& call = trace[i];
+            std::fprintf(file,
+                         "%s\n{\"name\": \"%s\", \"cat\": \"matrix\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                         "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"element_ops\": %llu, \"bytes\": %llu, "
+                         "\"allocations\": %llu, \"threads\": %d, \"kernel\": \"%s\"}}",
+                         i ? "," : "", call.operation, call.thread, call.startNanoseconds / 1000.0,
+                         call.nanoseconds / 1000.0, call.elementOps, call.bytes, call.allocations,
+                         call.threads, call.kernel != nullptr ? kernelName(call).c_str() : "");
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+    // Per-thread allocation counters, bumped by every matrix buffer
+    // allocation and read by scopes on entry and exit
+    struct ThreadCounters {
+        unsigned long long allocations;
+        unsigned long long bytes;
+    };
+
+    static ThreadCounters& threadCounters() {
+        static thread_local ThreadCounters counters = ThreadCounters();
+        return counters;
+    }
+
+    static void countAllocation(std::size_t bytes) {
+        ThreadCounters& counters = threadCounters();
+        counters.allocations++;
+        counters.bytes += bytes;
+    }
+
+    static int threadId() {
+        static std::atomic<int> next(0);
+        static thread_local int id = next.fetch_add(1, std::memory_order_relaxed);
+        return id;
+    }
+
+private:
+    const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    mutable std::mutex mutex;
+    std::map<std::string, MatrixOperationStats> totals;
+    std::vector<MatrixOperationRecord> events;
+    unsigned long long droppedEvents = 0;
+    std::atomic<bool> tracing{false};
+
+    static std::string kernelName(const MatrixOperationRecord& call) {
+        return call.isa != nullptr ? std::string(call.kernel) + "/" + call.isa : std::string(call.kernel);
+    }
+};
+
+// MatrixInstrumentationScope - times one call and reports it on exit
+class MatrixInstrumentationScope {
+private:
+    MatrixOperationRecord call;
+    MatrixInstrumentation::ThreadCounters allocationsBefore;
+
+public:
+    explicit MatrixInstrumentationScope(const char* operation)
+        : call(), allocationsBefore(MatrixInstrumentation::threadCounters()) {
+        call.operation = operation;
+        call.threads = 1;
+        call.thread = MatrixInstrumentation::threadId();
+        call.startNanoseconds = MatrixInstrumentation::instance().now();
+    }
+
+    MatrixInstrumentationScope(const MatrixInstrumentationScope&) = delete;
+    MatrixInstrumentationScope& operator=(const MatrixInstrumentationScope&) = delete;
+
+    ~MatrixInstrumentationScope() {
+        MatrixInstrumentation& instrumentation = MatrixInstrumentation::instance();
+        const MatrixInstrumentation::ThreadCounters& after = MatrixInstrumentation::threadCounters();
+        call.nanoseconds = instrumentation.now() - call.startNanoseconds;
+        call.allocations = after.allocations - allocationsBefore.allocations;
+        call.allocatedBytes = after.bytes - allocationsBefore.bytes;
+        instrumentation.record(call);
+    }
+
+    void work(unsigned long long elementOps, unsigned long long bytes) {
+        call.elementOps = elementOps;
+        call.bytes = bytes;
+    }
+
+    void kernel(const char* name, const char* isa, int threads) {
+        call.kernel = name;
+        call.isa = isa;
+        call.threads = threads;
+    }
+
+    // rows x cols elements, each reading and writing operands elements
+    // through the dispatched SIMD kernels
+    void elementwise(unsigned long long rows, unsigned long long cols, int operands, std::size_t elementSize) {
+        work(rows * cols, rows * cols * operands * elementSize);
+        kernel("elementwise", simdLevelName(SimdDispatch::level()), 1);
+    }
+
+    // An m x n x k product through GemmKernel
+    void gemm(unsigned long long m, unsigned long long n, unsigned long long k, std::size_t elementSize,
+              std::size_t accumulatorSize, int threads) {
+        work(m * n * k, (m * k + k * n) * elementSize + m * n * accumulatorSize);
+        kernel("gemm", simdLevelName(SimdDispatch::level()), threads);
+    }
+};
+
+#define MATRIX_INSTRUMENT(operation) MatrixInstrumentationScope matrixInstrumentationScope(operation)
+#define MATRIX_INSTRUMENT_WORK(elementOps, bytes) matrixInstrumentationScope.work((elementOps), (bytes))
+#define MATRIX_INSTRUMENT_KERNEL(name, isa, threads) matrixInstrumentationScope.kernel((name), (isa), (threads))
+#define MATRIX_INSTRUMENT_ELEMENTWISE(rows, cols, operands, elementSize) \
+    matrixInstrumentationScope.elementwise((rows), (cols), (operands), (elementSize))
+#define MATRIX_INSTRUMENT_GEMM(m, n, k, elementSize, accumulatorSize, threads) \
+    matrixInstrumentationScope.gemm((m), (n), (k), (elementSize), (accumulatorSize), (threads))
+#define MATRIX_INSTRUMENT_ALLOCATION(bytes) MatrixInstrumentation::countAllocation(bytes)
+
+#else
+
+#define MATRIX_INSTRUMENT(operation) ((void)0)
+#define MATRIX_INSTRUMENT_WORK(elementOps, bytes) ((void)0)
+#define MATRIX_INSTRUMENT_KERNEL(name, isa, threads) ((void)0)
+#define MATRIX_INSTRUMENT_ELEMENTWISE(rows, cols, operands, elementSize) ((void)0)
+#define MATRIX_INSTRUMENT_GEMM(m, n, k, elementSize, accumulatorSize, threads) ((void)0)
+#define MATRIX_INSTRUMENT_ALLOCATION(bytes) ((void)0)
+
+#endif // MATRIX_ENABLE_INSTRUMENTATION
+
+#endif // MATRIX_INSTRUMENTATION_H
@@ -0,0 +1,386 @@
+#ifndef MATRIX_LU_H
+#define MATRIX_LU_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "gemm.h"
+#include "thread_pool.h"
+
+// LuKernel - LU decomposition with partial pivoting, P A = L U, and the
+// solves built on it.
+//
+// factor() is blocked and right-looking: each block column of BLOCK
+// columns is factored as a tall panel, the matching block row of U is
+// found by a unit lower triangular solve split by columns across the
+// thread pool, and the trailing submatrix is updated with one
+// A22 -= L21 * U12 through the packed parallel GEMM. That update carries
+// nearly all of the O(n^3) work, so the factorization runs at close to
+// GEMM speed. L (unit diagonal, not stored) and U overwrite A; pivots are
+// LAPACK-style row interchanges, row k having been swapped with pivots[k].
+class LuKernel {
+public:
+    static constexpr int BLOCK = 96;
+
+    // Work (multiply-adds) below which a triangular solve stays on the
+    // calling thread
+    static constexpr long long PARALLEL_WORK = 1LL << 18;
+
+    // Factor the n x n matrix a in place. Returns the sign of the row
+    // permutation, or 0 when a zero pivot makes the matrix singular (the
+    // factorization still completes, as in LAPACK).
+    template <typename F>
+    static int factor(int n, F* a, std::ptrdiff_t lda, int* pivots) {
+        int sign = 1;
+        bool singular = false;
+        for (int k0 = 0; k0 < n; k0 += BLOCK) {
+            const int nb = std::min(BLOCK, n - k0);
+            for (int k = k0; k < k0 + nb; k++) {
+                int p = k;
+                for (int i = k + 1; i < n; i++) {
+                    if (std::abs(a[i * lda + k]) > std::abs(a[p * lda + k])) {
+                        p = i;
+                    }
+                }
+                pivots[k] = p;
+                if (a[p * lda + k] == F(0)) {
+                    singular = true;
+                    continue;
+                }
+                if (p != k) {
+                    std::swap_ranges(a + k * lda, a + k * lda + n, a + p * lda);
+                    sign = -sign;
+                }
+                // Column of L, then the rank-1 update inside the panel
+                const F inverse = F(1) / a[k * lda + k];
+                const F* uk = a + k * lda;
+                for (int i = k + 1; i < n; i++) {
+                    F* ai = a + i * lda;
+                    const F l = ai[k] *= inverse;
+                    for (int j = k + 1; j < k0 + nb; j++) {
+                        ai[j] -= l * uk[j];
+                    }
+                }
+            }
+
+            const int rest = n - k0 - nb;
+            if (rest > 0) {
+                F* a11 = a + k0 * lda + k0;
+                // U12 = L11^-1 A12
+                lowerSolve(nb, a11, lda, rest, a11 + nb, lda);
+                // A22 -= L21 U12
+                GemmKernel<F>::multiplyParallel(rest, rest, nb, F(-1),
+                                                a11 + nb * lda, lda, 1,
+                                                a11 + nb, lda, 1,
+                                                F(1), a11 + nb * lda + nb, lda, 0, 0);
+            }
+        }
+        return singular ? 0 : sign;
+    }
+
+    // Overwrite the n x nrhs right-hand side b with the solution of
+    // A X = B, given the output of factor()
+    template <typename F>
+    static void solve(int n, const F* lu, std::ptrdiff_t lda, const int* pivots,
+                      int nrhs, F* b, std::ptrdiff_t ldb) {
+        for (int k = 0; k < n; k++) {
+            if (pivots[k] != k) {
+                std::swap_ranges(b + k * ldb, b + k * ldb + nrhs, b + pivots[k] * ldb);
+            }
+        }
+        lowerSolve(n, lu, lda, nrhs, b, ldb);
+        upperSolve(n, lu, lda, nrhs, b, ldb);
+    }
+
+    // Exact determinant of an integer matrix by fraction-free (Bareiss)
+    // elimination: every intermediate is itself a minor of a, so each
+    // division is exact. Intermediates are held in BareissWide (128 bits
+    // where the compiler has them); returns false if one of them
+    // overflows or the determinant does not fit in a long long.
+    template <typename I>
+    static bool bareissDeterminant(int n, const I* a, std::ptrdiff_t rowStride, std::ptrdiff_t colStride,
+                                   long long& determinant) {
+        typedef BareissWide Wide;
+        std::vector<Wide> m(static_cast<std::size_t>(n) * n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                if (!widen(a[i * rowStride + j * colStride], m[static_cast<std::size_t>(i) * n + j])) {
+                    return false;
+                }
+            }
+        }
+        int sign = 1;
+        Wide previous = 1;
+        for (int k = 0; k + 1 < n; k++) {
+            Wide* mk = &m[static_cast<std::size_t>(k) * n];
+            if (mk[k] == 0) {
+                int p = k + 1;
+                while (p < n && m[static_cast<std::size_t>(p) * n + k] == 0) {
+                    p++;
+                }
+                if (p == n) {
+                    determinant = 0;
+                    return true;
+                }
+                std::swap_ranges(mk, mk + n, &m[static_cast<std::size_t>(p) * n]);
+                sign = -sign;
+            }
+            for (int i = k + 1; i < n; i++) {
+                Wide* mi = &m[static_cast<std::size_t>(i) * n];
+                for (int j = k + 1; j < n; j++) {
+                    if (!bareissStep(mk[k], mi[j], mi[k], mk[j], previous, mi[j])) {
+                        return false;
+                    }
+                }
+            }
+            previous = mk[k];
+        }
+        return narrow(n > 0 ? m[static_cast<std::size_t>(n) * n - 1] : 1, sign, determinant);
+    }
+
+    // Band storage for the band kernels below: row i of an n x n matrix
+    // with kl sub- and ku super-diagonals keeps columns i - kl ..
+    // i + kl + ku, element (i, j) at band[i * bandWidth(kl, ku) + j - i + kl].
+    // The kl extra super-diagonals hold the fill-in row interchanges cause.
+    static int bandWidth(int kl, int ku) { return 2 * kl + ku + 1; }
+
+    // Factor a band matrix in place with partial pivoting, LAPACK gbtf2
+    // style: the pivot for column k is sought among rows k .. k + kl only,
+    // so L keeps kl sub-diagonals, U gains at most kl super-diagonals and
+    // the work is O(n kl (kl + ku)). Multipliers stay where they were
+    // computed (later interchanges do not move them), which is the order
+    // bandSolve() applies them in. Returns as factor() does.
+    template <typename F>
+    static int bandFactor(int n, int kl, int ku, F* band, int* pivots) {
+        const int width = bandWidth(kl, ku);
+        auto at = [=](int i, int j) -> F& { return band[static_cast<std::size_t>(i) * width + j - i + kl]; };
+        int sign = 1;
+        bool singular = false;
+        for (int k = 0; k < n; k++) {
+            const int lastRow = std::min(n - 1, k + kl);
+            const int lastCol = std::min(n - 1, k + kl + ku);
+            int p = k;
+            for (int i = k + 1; i <= lastRow; i++) {
+                if (std::abs(at(i, k)) > std::abs(at(p, k))) {
+                    p = i;
+                }
+            }
+            pivots[k] = p;
+            if (at(p, k) == F(0)) {
+                singular = true;
+                continue;
+            }
+            if (p != k) {
+                for (int j = k; j <= lastCol; j++) {
+                    std::swap(at(k, j), at(p, j));
+                }
+                sign = -sign;
+            }
+            const F inverse = F(1) / at(k, k);
+            for (int i = k + 1; i <= lastRow; i++) {
+                const F l = at(i, k) * inverse;
+                at(i, k) = l;
+                if (l == F(0)) {
+                    continue;
+                }
+                for (int j = k + 1; j <= lastCol; j++) {
+                    at(i, j) -= l * at(k, j);
+                }
+            }
+        }
+        return singular ? 0 : sign;
+    }
+
+    // b (n x nrhs) = A^-1 b from bandFactor()'s output
+    template <typename F>
+    static void bandSolve(int n, int kl, int ku, const F* band, const int* pivots, int nrhs, F* b,
+                          std::ptrdiff_t ldb) {
+        const int width = bandWidth(kl, ku);
+        auto at = [=](int i, int j) { return band[static_cast<std::size_t>(i) * width + j - i + kl]; };
+        for (int k = 0; k < n; k++) {
+            F* bk = b + k * ldb;
+            if (pivots[k] != k) {
+                std::swap_ranges(bk, bk + nrhs, b + pivots[k] * ldb);
+            }
+            for (int i = k + 1; i <= std::min(n - 1, k + kl); i++) {
+                const F l = at(i, k);
+                F* bi = b + i * ldb;
+                for (int j = 0; j < nrhs; j++) {
+                    bi[j] -= l * bk[j];
+                }
+            }
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            F* bi = b + i * ldb;
+            for (int k = i + 1; k <= std::min(n - 1, i + kl + ku); k++) {
+                const F u = at(i, k);
+                const F* bk = b + k * ldb;
+                for (int j = 0; j < nrhs; j++) {
+                    bi[j] -= u * bk[j];
+                }
+            }
+            const F inverse = F(1) / at(i, i);
+            for (int j = 0; j < nrhs; j++) {
+                bi[j] *= inverse;
+            }
+        }
+    }
+
+    // bareissDeterminant() for a band matrix in band storage. Rows below
+    // the band are untouched by a Bareiss step except for being scaled by
+    // pivot / previous, and those factors telescope, so a row is brought
+    // up to date with a single multiplication by the previous pivot when
+    // it enters the band. The work stays O(n kl (kl + ku)).
+    template <typename I>
+    static bool bandBareissDeterminant(int n, int kl, int ku, const I* band, long long& determinant) {
+        typedef BareissWide Wide;
+        const int width = bandWidth(kl, ku);
+        std::vector<Wide> m(static_cast<std::size_t>(n) * width);
+        for (std::size_t p = 0; p < m.size(); p++) {
+            if (!widen(band[p], m[p])) {
+                return false;
+            }
+        }
+        auto at = [&](int i, int j) -> Wide& { return m[static_cast<std::size_t>(i) * width + j - i + kl]; };
+        int sign = 1;
+        Wide previous = 1;
+        int entered = 0; // rows below this are up to date
+        for (int k = 0; k < n; k++) {
+            const int lastRow = std::min(n - 1, k + kl);
+            const int lastCol = std::min(n - 1, k + kl + ku);
+            for (; entered <= lastRow; entered++) {
+                for (int j = std::max(0, entered - kl); j <= std::min(n - 1, entered + ku); j++) {
+                    if (__builtin_mul_overflow(at(entered, j), previous, &at(entered, j))) {
+                        return false;
+                    }
+                }
+            }
+            if (k == n - 1) {
+                break;
+            }
+            int p = k;
+            while (p <= lastRow && at(p, k) == 0) {
+                p++;
+            }
+            if (p > lastRow) {
+                determinant = 0;
+                return true;
+            }
+            if (p != k) {
+                for (int j = k; j <= lastCol; j++) {
+                    std::swap(at(k, j), at(p, j));
+                }
+                sign = -sign;
+            }
+            for (int i = k + 1; i <= lastRow; i++) {
+                for (int j = k + 1; j <= lastCol; j++) {
+                    if (!bareissStep(at(k, k), at(i, j), at(i, k), at(k, j), previous, at(i, j))) {
+                        return false;
+                    }
+                }
+            }
+            previous = at(k, k);
+        }
+        return narrow(n > 0 ? at(n - 1, n - 1) : 1, sign, determinant);
+    }
+
+private:
+    // Bareiss intermediates. Without a 128-bit type they are held in long
+    // long: every step is overflow checked, so such targets only report
+    // "does not fit" for smaller matrices.
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef __int128 BareissWide;
+#else
+    typedef long long BareissWide;
+#endif
+
+    template <typename I>
+    static bool widen(I value, BareissWide& wide) {
+        return !__builtin_add_overflow(value, 0, &wide);
+    }
+
+    // (pivot * element - left * above) / previous, exact by Bareiss. The
+    // quotient is a minor, but the products before the division can
+    // outgrow BareissWide long before it does.
+    static bool bareissStep(BareissWide pivot, BareissWide element, BareissWide left, BareissWide above,
+                            BareissWide previous, BareissWide& result) {
+        BareissWide product1, product2, difference;
+        if (__builtin_mul_overflow(pivot, element, &product1) || __builtin_mul_overflow(left, above, &product2)
+            || __builtin_sub_overflow(product1, product2, &difference)) {
+            return false;
+        }
+        // Dividing the most negative value by -1 overflows too
+        if (previous == -1) {
+            return !__builtin_sub_overflow(BareissWide(0), difference, &result);
+        }
+        result = difference / previous;
+        return true;
+    }
+
+    // sign * last as a long long
+    static bool narrow(BareissWide last, int sign, long long& determinant) {
+        BareissWide result;
+        return !__builtin_mul_overflow(last, static_cast<BareissWide>(sign), &result)
+               && !__builtin_add_overflow(result, 0, &determinant);
+    }
+
+    // b (n x nrhs) = L^-1 b for the unit lower triangle of l; columns of b
+    // are independent, so wide right-hand sides are split across threads
+    template <typename F>
+    static void lowerSolve(int n, const F* l, std::ptrdiff_t ldl, int nrhs, F* b, std::ptrdiff_t ldb) {
+        forColumnChunks(n, nrhs, [=](int c0, int c1) {
+            for (int i = 1; i < n; i++) {
+                F* bi = b + i * ldb;
+                for (int k = 0; k < i; k++) {
+                    const F lik = l[i * ldl + k];
+                    const F* bk = b + k * ldb;
+                    for (int j = c0; j < c1; j++) {
+                        bi[j] -= lik * bk[j];
+                    }
+                }
+            }
+        });
+    }
+
+    // b = U^-1 b for the upper triangle (diagonal included) of u
+    template <typename F>
+    static void upperSolve(int n, const F* u, std::ptrdiff_t ldu, int nrhs, F* b, std::ptrdiff_t ldb) {
+        forColumnChunks(n, nrhs, [=](int c0, int c1) {
+            for (int i = n - 1; i >= 0; i--) {
+                F* bi = b + i * ldb;
+                for (int k = i + 1; k < n; k++) {
+                    const F uik = u[i * ldu + k];
+                    const F* bk = b + k * ldb;
+                    for (int j = c0; j < c1; j++) {
+                        bi[j] -= uik * bk[j];
+                    }
+                }
+                const F inverse = F(1) / u[i * ldu + i];
+                for (int j = c0; j < c1; j++) {
+                    bi[j] *= inverse;
+                }
+            }
+        });
+    }
+
+    // body(c0, c1) over column chunks of an n-row triangular solve
+    template <typename Body>
+    static void forColumnChunks(int n, int nrhs, const Body& body) {
+        const long long work = static_cast<long long>(n) * n * nrhs / 2;
+        if (work < PARALLEL_WORK || nrhs < 32) {
+            body(0, nrhs);
+            return;
+        }
+        ThreadPool& pool = ThreadPool::instance();
+        // Chunks of whole cache lines, several per thread
+        const int chunks = std::min((nrhs + 15) / 16, 4 * pool.size());
+        pool.parallelFor(chunks, 0, [&](int t) {
+            body(static_cast<int>(static_cast<long long>(nrhs) * t / chunks),
+                 static_cast<int>(static_cast<long long>(nrhs) * (t + 1) / chunks));
+        });
+    }
+};
+
+#endif // MATRIX_LU_H
@@ -1,5 +1,7 @@
 #include "utility.h"
+#include "script.h"
 #include <iostream>
+#include <string>
 
 using namespace std;
 
@@ -278,9 +280,42 @@ void demonstrateClassSeparation() {
     cout << "Are matrices equal? " << (MatrixOperations::isEqual(m1, m2) ? "Yes" : "No") << "\n\n";
 }
 
-int main() {
+void printUsage(const char* program) {
+    cout << "Usage: " << program << "                  interactive menu\n";
+    cout << "       " << program << " --script FILE    run a script file (- for stdin)\n";
+    cout << "       " << program << " -e STATEMENTS    run statements given inline\n";
+}
+
+// Batch mode - run a script of matrix statements without prompting
+int runScript(int argc, char* argv[]) {
+    string option = argv[1];
+    if (argc != 3 || (option != "--script" && option != "-e")) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    MatrixScript script;
+    string source = argv[2];
+    if (option == "-e") {
+        return script.run(source) ? 0 : 1;
+    }
+    if (source == "-") {
+        string text, line;
+        while (getline(cin, line)) {
+            text += line + "\n";
+        }
+        return script.run(text) ? 0 : 1;
+    }
+    return script.runFile(source) ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
     int choice;
     
+    if (argc > 1) {
+        return runScript(argc, argv);
+    }
+    
     cout << "Matrix Operations Program with Separated Classes\n";
     cout << "===============================================\n";
     
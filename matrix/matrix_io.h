@@ -0,0 +1,367 @@
+#ifndef MATRIX_MATRIX_IO_H
+#define MATRIX_MATRIX_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MATRIX_FILE_MMAP 1
+#endif
+
+#include "utility.h"
+
+// Element type codes stored in a matrix file
+enum class MatrixFileType : std::uint32_t {
+    Int8 = 1,
+    UInt8 = 2,
+    Int16 = 3,
+    UInt16 = 4,
+    Int32 = 5,
+    UInt32 = 6,
+    Int64 = 7,
+    UInt64 = 8,
+    Float32 = 9,
+    Float64 = 10
+};
+
+template <typename T>
+struct MatrixFileTypeOf;
+
+#define MATRIX_FILE_TYPE(type, code)                                    \
+    template <>                                                         \
+    struct MatrixFileTypeOf<type> {                                     \
+        static constexpr MatrixFileType value = MatrixFileType::code;   \
+    };
+
+MATRIX_FILE_TYPE(std::int8_t, Int8)
+MATRIX_FILE_TYPE(std::uint8_t, UInt8)
+MATRIX_FILE_TYPE(std::int16_t, Int16)
+MATRIX_FILE_TYPE(std::uint16_t, UInt16)
+MATRIX_FILE_TYPE(std::int32_t, Int32)
+MATRIX_FILE_TYPE(std::uint32_t, UInt32)
+MATRIX_FILE_TYPE(std::int64_t, Int64)
+MATRIX_FILE_TYPE(std::uint64_t, UInt64)
+MATRIX_FILE_TYPE(float, Float32)
+MATRIX_FILE_TYPE(double, Float64)
+
+#undef MATRIX_FILE_TYPE
+
+// On-disk header, 64 bytes, followed directly by the element data. Rows
+// are stored stride elements apart with zeroed padding, exactly as
+// BasicMatrix lays them out in memory, so a mapping of the file can serve
+// as matrix storage as it stands. Data starts 64 bytes into the file and
+// therefore on a cache line of the (page aligned) mapping.
+struct MatrixFileHeader {
+    char magic[8];             // "CPMATRIX"
+    std::uint32_t version;
+    std::uint32_t byteOrder;   // BYTE_ORDER_MARK as written by the producer
+    std::uint32_t elementType; // MatrixFileType
+    std::uint32_t elementSize;
+    std::int32_t rows;
+    std::int32_t cols;
+    std::int32_t stride;       // elements between row starts
+    std::uint32_t reserved;    // zero
+    std::uint64_t dataBytes;
+    std::uint64_t checksum;    // MatrixFile::checksum() of the data
+    std::uint64_t reserved2;   // zero
+};
+
+static_assert(sizeof(MatrixFileHeader) == 64, "matrix file header must be 64 bytes");
+
+// MatrixFile - binary load/save.
+//
+// load() maps the file copy-on-write and hands the mapping to the matrix
+// as its storage: opening costs a few system calls regardless of size,
+// pages are read on first touch and stay shared with every other process
+// mapping the same file until someone writes to them. Where mmap() is not
+// available the data is read into a matrix of its own instead. Errors are
+// reported like the rest of the library and yield an empty matrix.
+class MatrixFile {
+public:
+    static constexpr std::uint32_t VERSION = 1;
+    static constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr std::size_t DATA_OFFSET = sizeof(MatrixFileHeader);
+
+    // FNV-1a over 64-bit little-endian words (the tail is zero-extended),
+    // continuing from hash; start from CHECKSUM_SEED
+    static constexpr std::uint64_t CHECKSUM_SEED = 14695981039346656037ULL;
+
+    static std::uint64_t checksum(const void* data, std::size_t bytes, std::uint64_t hash = CHECKSUM_SEED) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        std::size_t i = 0;
+        for (; i + 8 <= bytes; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p + i, 8);
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+        if (i < bytes) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, p + i, bytes - i);
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Map a matrix file. verify re-reads every page to check the checksum,
+    // which gives up the constant-time open.
+    template <typename T>
+    static BasicMatrix<T> load(const std::string& path, bool verify = false) {
+#ifdef MATRIX_FILE_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cout << "Error: Cannot open matrix file " << path << "!\n";
+            return BasicMatrix<T>();
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < DATA_OFFSET) {
+            ::close(fd);
+            std::cout << "Error: " << path << " is not a matrix file!\n";
+            return BasicMatrix<T>();
+        }
+        const std::size_t length = static_cast<std::size_t>(info.st_size);
+        void* base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            std::cout << "Error: Cannot map matrix file " << path << "!\n";
+            return BasicMatrix<T>();
+        }
+        std::shared_ptr<void> mapping(base, [length](void* p) { ::munmap(p, length); });
+
+        MatrixFileHeader header;
+        std::memcpy(&header, base, sizeof(header));
+        if (!checkHeader<T>(header, length, path)) {
+            return BasicMatrix<T>();
+        }
+        T* data = reinterpret_cast<T*>(static_cast<char*>(base) + DATA_OFFSET);
+        if (verify && checksum(data, header.dataBytes) != header.checksum) {
+            std::cout << "Error: Checksum mismatch in " << path << "!\n";
+            return BasicMatrix<T>();
+        }
+        if (header.rows == 0) {
+            return BasicMatrix<T>();
+        }
+        return BasicMatrix<T>(data, header.rows, header.cols, header.stride, std::move(mapping));
+#else
+        return loadCopy<T>(path, verify);
+#endif
+    }
+
+    // Write a matrix in its in-memory layout; returns false on failure
+    template <typename T>
+    static bool save(const std::string& path, const BasicMatrix<T>& matrix1);
+
+    // Header for a rows x cols matrix of T laid out as BasicMatrix pads it;
+    // the checksum is left zero
+    template <typename T>
+    static MatrixFileHeader makeHeader(int rows, int cols) {
+        if (rows <= 0 || cols <= 0) {
+            rows = 0;
+            cols = 0;
+        }
+        MatrixFileHeader header = MatrixFileHeader();
+        std::memcpy(header.magic, "CPMATRIX", 8);
+        header.version = VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.elementType = static_cast<std::uint32_t>(MatrixFileTypeOf<T>::value);
+        header.elementSize = sizeof(T);
+        header.rows = rows;
+        header.cols = cols;
+        header.stride = static_cast<std::int32_t>(paddedStride<T>(cols));
+        header.dataBytes = static_cast<std::uint64_t>(rows) * header.stride * sizeof(T);
+        return header;
+    }
+
+#ifdef MATRIX_FILE_MMAP
+    // Read and check the header of an open matrix file, for callers that
+    // access the data themselves
+    template <typename T>
+    static bool readHeader(int fd, const std::string& path, MatrixFileHeader& header) {
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < DATA_OFFSET
+            || ::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            std::cout << "Error: " << path << " is not a matrix file!\n";
+            return false;
+        }
+        return checkHeader<T>(header, static_cast<std::size_t>(info.st_size), path);
+    }
+#endif
+
+private:
+#ifndef MATRIX_FILE_MMAP
+    template <typename T>
+    static BasicMatrix<T> loadCopy(const std::string& path, bool verify) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            std::cout << "Error: Cannot open matrix file " << path << "!\n";
+            return BasicMatrix<T>();
+        }
+        MatrixFileHeader header;
+        long length = -1;
+        if (std::fread(&header, sizeof(header), 1, file) != 1 || std::fseek(file, 0, SEEK_END) != 0
+            || (length = std::ftell(file)) < static_cast<long>(DATA_OFFSET)
+            || std::fseek(file, static_cast<long>(DATA_OFFSET), SEEK_SET) != 0) {
+            std::fclose(file);
+            std::cout << "Error: " << path << " is not a matrix file!\n";
+            return BasicMatrix<T>();
+        }
+        if (!checkHeader<T>(header, static_cast<std::size_t>(length), path) || header.rows == 0) {
+            std::fclose(file);
+            return BasicMatrix<T>();
+        }
+        // BasicMatrix pads rows exactly as the file does
+        BasicMatrix<T> result(header.rows, header.cols);
+        const std::size_t bytes = static_cast<std::size_t>(header.dataBytes);
+        const bool read = std::fread(result.data(), 1, bytes, file) == bytes;
+        std::fclose(file);
+        if (!read) {
+            std::cout << "Error: Cannot read matrix file " << path << "!\n";
+            return BasicMatrix<T>();
+        }
+        if (verify && checksum(result.data(), bytes) != header.checksum) {
+            std::cout << "Error: Checksum mismatch in " << path << "!\n";
+            return BasicMatrix<T>();
+        }
+        return result;
+    }
+#endif
+
+    // Row stride BasicMatrix uses for cols columns of T, in 64 bits so
+    // that a hostile cols cannot overflow it
+    template <typename T>
+    static std::int64_t paddedStride(std::int64_t cols) {
+        const std::int64_t perLine = static_cast<std::int64_t>(BasicMatrix<T>::ALIGNMENT / sizeof(T));
+        return (cols + perLine - 1) / perLine * perLine;
+    }
+
+    template <typename T>
+    static bool checkHeader(const MatrixFileHeader& header, std::size_t length, const std::string& path) {
+        if (std::memcmp(header.magic, "CPMATRIX", 8) != 0 || header.version != VERSION) {
+            std::cout << "Error: " << path << " is not a matrix file!\n";
+            return false;
+        }
+        if (header.byteOrder != BYTE_ORDER_MARK) {
+            std::cout << "Error: " << path << " was written with a different byte order!\n";
+            return false;
+        }
+        if (header.elementType != static_cast<std::uint32_t>(MatrixFileTypeOf<T>::value)
+            || header.elementSize != sizeof(T)) {
+            std::cout << "Error: " << path << " holds a different element type!\n";
+            return false;
+        }
+        // The stride must be the one makeHeader() writes, and the data size
+        // is computed with overflow checks: a crafted header must not pass
+        // with row extents that run past the end of the file
+        const bool empty = header.rows == 0 && header.cols == 0 && header.stride == 0;
+        const bool shaped = header.rows > 0 && header.cols > 0 && header.stride == paddedStride<T>(header.cols);
+        std::uint64_t dataBytes = 0;
+        if ((!empty && !shaped)
+            || __builtin_mul_overflow(static_cast<std::uint64_t>(header.rows),
+                                      static_cast<std::uint64_t>(header.stride) * sizeof(T), &dataBytes)
+            || header.dataBytes != dataBytes || header.dataBytes > length - DATA_OFFSET) {
+            std::cout << "Error: " << path << " has an inconsistent header!\n";
+            return false;
+        }
+        return true;
+    }
+};
+
+// MatrixFileWriter - streams a matrix file one row at a time, so results
+// larger than memory (or produced incrementally) can be written without
+// ever holding the whole matrix. The checksum is accumulated as rows pass
+// through and the header is completed by close().
+template <typename T>
+class MatrixFileWriter {
+private:
+    std::FILE* file;
+    std::string path;
+    MatrixFileHeader header;
+    int rowsWritten;
+    std::uint64_t hash;
+    std::vector<T> padded;
+    bool failed;
+
+public:
+    static constexpr std::size_t BUFFER_BYTES = 1 << 20;
+
+    MatrixFileWriter(const std::string& filePath, int rows, int cols)
+        : file(nullptr), path(filePath), header(MatrixFile::makeHeader<T>(rows, cols)), rowsWritten(0),
+          hash(MatrixFile::CHECKSUM_SEED), failed(false) {
+        padded.assign(static_cast<std::size_t>(header.stride), T());
+
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            std::cout << "Error: Cannot create matrix file " << path << "!\n";
+            failed = true;
+            return;
+        }
+        std::setvbuf(file, nullptr, _IOFBF, BUFFER_BYTES);
+        // Placeholder until the checksum is known
+        failed = std::fwrite(&header, sizeof(header), 1, file) != 1;
+    }
+
+    MatrixFileWriter(const MatrixFileWriter&) = delete;
+    MatrixFileWriter& operator=(const MatrixFileWriter&) = delete;
+
+    ~MatrixFileWriter() {
+        close();
+    }
+
+    // Append the next row (cols elements)
+    bool writeRow(const T* row) {
+        if (failed || file == nullptr || rowsWritten >= header.rows) {
+            return false;
+        }
+        std::memcpy(padded.data(), row, static_cast<std::size_t>(header.cols) * sizeof(T));
+        const std::size_t bytes = padded.size() * sizeof(T);
+        hash = MatrixFile::checksum(padded.data(), bytes, hash);
+        if (std::fwrite(padded.data(), 1, bytes, file) != bytes) {
+            failed = true;
+            return false;
+        }
+        rowsWritten++;
+        return true;
+    }
+
+    // Finish the file; fails if fewer rows than announced were written
+    bool close() {
+        if (file == nullptr) {
+            return !failed;
+        }
+        if (!failed && rowsWritten == header.rows) {
+            header.checksum = hash;
+            failed = std::fseek(file, 0, SEEK_SET) != 0
+                     || std::fwrite(&header, sizeof(header), 1, file) != 1;
+        } else {
+            failed = true;
+        }
+        failed = std::fclose(file) != 0 || failed;
+        file = nullptr;
+        if (failed) {
+            std::cout << "Error: Failed to write matrix file " << path << "!\n";
+        }
+        return !failed;
+    }
+};
+
+template <typename T>
+bool MatrixFile::save(const std::string& path, const BasicMatrix<T>& matrix1) {
+    MatrixFileWriter<T> writer(path, matrix1.getRows(), matrix1.getCols());
+    for (int i = 0; i < matrix1.getRows(); i++) {
+        if (!writer.writeRow(matrix1.data() + static_cast<std::size_t>(i) * matrix1.stride())) {
+            break;
+        }
+    }
+    return writer.close();
+}
+
+#endif // MATRIX_MATRIX_IO_H
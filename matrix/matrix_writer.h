@@ -0,0 +1,232 @@
+#ifndef MATRIX_WRITER_H
+#define MATRIX_WRITER_H
+
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define MATRIX_WRITER_FD 1
+#endif
+
+#include "element_traits.h"
+#include "view.h"
+
+// Text layouts MatrixWriter knows. Aligned right-aligns every element to
+// the field width and follows each with the delimiter, the layout
+// displayMatrix() prints; Csv and Tsv separate unpadded elements with a
+// comma or tab.
+enum class MatrixTextFormat {
+    Aligned,
+    Csv,
+    Tsv
+};
+
+// MatrixWriter - fast text output for matrices.
+//
+// Elements are formatted with std::to_chars straight into one reusable
+// buffer, which is handed to the target (a file descriptor, a FILE* or an
+// ostream) in large chunks, so output runs at a small multiple of the
+// target's bandwidth instead of paying iostream's per-element formatting,
+// locale and sentry costs. Integers print exactly as iostreams would;
+// floating-point values use precision significant digits in %g style (6,
+// the iostream default, unless changed; negative gives the shortest text
+// that reads back to the same value).
+//
+// Output is buffered until flush() or destruction. The writer does not
+// own its target; errors are sticky and reported by good(). File
+// descriptor targets exist only on POSIX systems.
+class MatrixWriter {
+public:
+    static constexpr std::size_t BUFFER_SIZE = std::size_t(1) << 20;
+    static constexpr int MAX_WIDTH = 256;
+    // %g output is at most precision digits plus sign, point and exponent,
+    // so this keeps every number within a field's 64 bytes
+    static constexpr int MAX_PRECISION = 48;
+
+#if defined(MATRIX_WRITER_FD)
+    explicit MatrixWriter(int descriptor, MatrixTextFormat format = MatrixTextFormat::Aligned)
+        : target(FD), fd(descriptor), file(nullptr), stream(nullptr) {
+        setFormat(format);
+    }
+#endif
+
+    explicit MatrixWriter(std::FILE* out, MatrixTextFormat format = MatrixTextFormat::Aligned)
+        : target(STDIO), fd(-1), file(out), stream(nullptr) {
+        setFormat(format);
+    }
+
+    explicit MatrixWriter(std::ostream& out, MatrixTextFormat format = MatrixTextFormat::Aligned)
+        : target(STREAM), fd(-1), file(nullptr), stream(&out) {
+        setFormat(format);
+    }
+
+    MatrixWriter(const MatrixWriter&) = delete;
+    MatrixWriter& operator=(const MatrixWriter&) = delete;
+
+    ~MatrixWriter() {
+        flush();
+    }
+
+    // Width 6 and " " for Aligned; no padding and "," or "\t" otherwise
+    void setFormat(MatrixTextFormat format) {
+        aligned = format == MatrixTextFormat::Aligned;
+        width = aligned ? 6 : 0;
+        delimiter = format == MatrixTextFormat::Csv ? "," : format == MatrixTextFormat::Tsv ? "\t" : " ";
+        precision = 6;
+    }
+
+    void setWidth(int w) { width = w < 0 ? 0 : w > MAX_WIDTH ? MAX_WIDTH : w; }
+    void setDelimiter(const std::string& text) { delimiter = text; }
+    // Clamped to MAX_PRECISION; negative selects shortest round-trip text
+    void setPrecision(int digits) { precision = digits > MAX_PRECISION ? MAX_PRECISION : digits; }
+
+    // One line per row of the view
+    template <typename T>
+    void write(const ConstMatrixView<T>& view1) {
+        typedef typename StreamTraits<T>::type Printed;
+        // Longest field: padding, any number, the delimiter
+        const std::size_t slack = static_cast<std::size_t>(width) + delimiter.size() + 64;
+        const std::size_t rowBytes = view1.getCols() * slack + 1;
+        reserve(view1.getRows() * rowBytes);
+        for (int i = 0; i < view1.getRows(); i++) {
+            // Check for room once per row when a whole row fits the buffer
+            const bool rowFits = rowBytes <= buffer.size();
+            if (rowFits && buffer.size() - used < rowBytes) {
+                flush();
+            }
+            for (int j = 0; j < view1.getCols(); j++) {
+                if (!rowFits && buffer.size() - used < slack + 1) {
+                    flush();
+                }
+                char digits[64];
+                const char* end = format(digits, digits + sizeof(digits), static_cast<Printed>(view1(i, j)),
+                                         std::is_floating_point<Printed>());
+                if (end == nullptr) {
+                    ok = false;
+                    return;
+                }
+                const std::size_t length = static_cast<std::size_t>(end - digits);
+                if (length < static_cast<std::size_t>(width)) {
+                    std::memset(&buffer[used], ' ', width - length);
+                    used += width - length;
+                }
+                std::memcpy(&buffer[used], digits, length);
+                used += length;
+                if (aligned || j + 1 < view1.getCols()) {
+                    std::memcpy(&buffer[used], delimiter.data(), delimiter.size());
+                    used += delimiter.size();
+                }
+            }
+            buffer[used++] = '\n';
+        }
+    }
+
+    void write(const std::string& text) {
+        if (buffer.size() - used < text.size()) {
+            flush();
+            reserve(text.size());
+            if (buffer.size() < text.size()) {
+                ok = ok && emit(text.data(), text.size());
+                return;
+            }
+        }
+        std::memcpy(&buffer[used], text.data(), text.size());
+        used += text.size();
+    }
+
+    // Hand everything buffered to the target; false once any write failed
+    bool flush() {
+        if (used > 0 && ok) {
+            ok = emit(buffer.data(), used);
+        }
+        used = 0;
+        return ok;
+    }
+
+    bool good() const { return ok; }
+
+private:
+    enum Target {
+        FD,
+        STDIO,
+        STREAM
+    };
+
+    Target target;
+    int fd;
+    std::FILE* file;
+    std::ostream* stream;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+    bool ok = true;
+    bool aligned = true;
+    int width = 0;
+    std::string delimiter;
+    int precision = 6;
+
+    // Grow the buffer towards what the next write needs, up to BUFFER_SIZE,
+    // so printing a small matrix does not allocate a megabyte
+    void reserve(std::size_t bytes) {
+        const std::size_t wanted = used + bytes;
+        if (wanted > buffer.size() && buffer.size() < BUFFER_SIZE) {
+            buffer.resize(wanted < BUFFER_SIZE ? wanted : BUFFER_SIZE);
+        }
+    }
+
+    // End of the text written to [first, last), or null if it did not fit
+    static char* checked(const std::to_chars_result& result) {
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+
+    template <typename T>
+    static char* format(char* first, char* last, T value, std::false_type) {
+        return checked(std::to_chars(first, last, value));
+    }
+
+    template <typename T>
+    char* format(char* first, char* last, T value, std::true_type) const {
+        if (precision < 0) {
+            return checked(std::to_chars(first, last, value));
+        }
+        return checked(std::to_chars(first, last, value, std::chars_format::general, precision));
+    }
+
+    bool emit(const char* data, std::size_t size) {
+        switch (target) {
+        case FD:
+#if defined(MATRIX_WRITER_FD)
+            while (size > 0) {
+                const ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                data += written;
+                size -= static_cast<std::size_t>(written);
+            }
+            return true;
+#else
+            return false;
+#endif
+        case STDIO:
+            return std::fwrite(data, 1, size, file) == size;
+        case STREAM:
+            stream->write(data, static_cast<std::streamsize>(size));
+            return static_cast<bool>(*stream);
+        }
+        return false;
+    }
+};
+
+#endif // MATRIX_WRITER_H
@@ -0,0 +1,317 @@
+#ifndef MATRIX_OUT_OF_CORE_H
+#define MATRIX_OUT_OF_CORE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "matrix_io.h"
+#include "utility.h"
+
+// OutOfCoreOperations - products of matrices that do not fit in memory.
+//
+// Operands and result live in matrix files (see MatrixFile) and only
+// tiles of them are ever resident. C is computed one tm x tn tile at a
+// time as the sum over k of A(i, k) B(k, j), each step running the
+// in-memory multiplyInto() with beta = 1 so partial products accumulate
+// in place. Tiles are read with pread() into two sets of buffers: while
+// one pair is multiplied, the next pair is already being read on a
+// background thread, and each finished C tile is written back while the
+// next one is computed, so I/O overlaps compute whenever the tiles are
+// large enough for the product to dominate.
+//
+// The memory budget covers every buffer: two A tiles, two B tiles, two C
+// tiles and the GEMM packing workspace of each thread the tile product
+// may run on (see footprint()). The tile edge is the largest multiple of
+// 64 for which all of them fit, clamped to the matrix dimensions; a
+// budget too small for 64 x 64 tiles is rejected. I/O per
+// multiply-add falls as the tile edge grows, so the budget should be as
+// large as can be spared.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+class OutOfCoreOperations {
+public:
+    static constexpr std::size_t DEFAULT_MEMORY_BUDGET = std::size_t(256) << 20;
+
+    struct TileShape {
+        int rows;  // of A and C
+        int cols;  // of B and C
+        int depth; // cols of A, rows of B
+    };
+
+    static constexpr int MIN_EDGE = 64;
+
+    // Bytes of tile buffers and GEMM packing workspace that tiles of the
+    // given edge need, the tile product running on up to threads threads
+    // (as passed to multiply())
+    static std::size_t footprint(int edge, int m, int n, int k, int threads) {
+        const int rows = std::min(edge, m);
+        const int cols = std::min(edge, n);
+        const int depth = std::min(edge, k);
+        const int size = ThreadPool::instance().size();
+        const int workers = threads == 1 ? 1 : threads > 0 ? std::min(threads, size) : size;
+        // 2 tiles each of A and B, 2 accumulator tiles of C
+        const std::size_t tiles = 2 * (static_cast<std::size_t>(rows) * depth + static_cast<std::size_t>(depth) * cols)
+                                      * sizeof(T)
+                                  + 2 * static_cast<std::size_t>(rows) * cols * sizeof(Acc);
+        return tiles + workers * GemmKernel<T, Acc>::workspaceElements(rows, cols, depth) * sizeof(Acc);
+    }
+
+    // Tile shape for an m x k by k x n product within memoryBudget bytes;
+    // all zero when even MIN_EDGE tiles do not fit
+    static TileShape tileShape(int m, int n, int k, std::size_t memoryBudget, int threads = 0) {
+        TileShape shape = { 0, 0, 0 };
+        // Start from the edge the tiles alone would allow and shrink until
+        // the packing workspace fits as well
+        const double perEdge = 4.0 * sizeof(T) + 2.0 * sizeof(Acc);
+        int edge = static_cast<int>(std::sqrt(static_cast<double>(memoryBudget) / perEdge)) / MIN_EDGE * MIN_EDGE;
+        edge = std::max(edge, MIN_EDGE);
+        edge = std::min(edge, (std::max(m, std::max(n, k)) + MIN_EDGE - 1) / MIN_EDGE * MIN_EDGE);
+        while (edge >= MIN_EDGE && footprint(edge, m, n, k, threads) > memoryBudget) {
+            edge -= MIN_EDGE;
+        }
+        if (edge < MIN_EDGE) {
+            return shape;
+        }
+        shape.rows = std::min(edge, m);
+        shape.cols = std::min(edge, n);
+        shape.depth = std::min(edge, k);
+        return shape;
+    }
+
+    // pathC = pathA * pathB, written as a matrix file of Acc. threads is
+    // passed on to the tile kernel (0 = all). pathC must not name the same
+    // file as either operand. Returns false on failure.
+    static bool multiply(const std::string& pathA, const std::string& pathB, const std::string& pathC,
+                         std::size_t memoryBudget = DEFAULT_MEMORY_BUDGET, int threads = 0) {
+        FileDescriptor fileA(::open(pathA.c_str(), O_RDONLY));
+        FileDescriptor fileB(::open(pathB.c_str(), O_RDONLY));
+        if (fileA.fd < 0 || fileB.fd < 0) {
+            std::cout << "Error: Cannot open " << (fileA.fd < 0 ? pathA : pathB) << "!\n";
+            return false;
+        }
+        MatrixFileHeader headerA;
+        MatrixFileHeader headerB;
+        if (!MatrixFile::readHeader<T>(fileA.fd, pathA, headerA) || !MatrixFile::readHeader<T>(fileB.fd, pathB, headerB)) {
+            return false;
+        }
+        if (headerA.rows == 0 || headerB.rows == 0 || headerA.cols != headerB.rows) {
+            std::cout << "Error: Cannot multiply " << headerA.rows << "x" << headerA.cols << " by "
+                      << headerB.rows << "x" << headerB.cols << " out of core!\n";
+            return false;
+        }
+
+        const int m = headerA.rows;
+        const int n = headerB.cols;
+        const int k = headerA.cols;
+        const TileShape shape = tileShape(m, n, k, memoryBudget, threads);
+        if (shape.rows == 0) {
+            std::cout << "Error: Memory budget of " << memoryBudget << " bytes is below the "
+                      << footprint(MIN_EDGE, m, n, k, threads) << " bytes out-of-core multiplication needs!\n";
+            return false;
+        }
+        MatrixFileHeader headerC = MatrixFile::makeHeader<Acc>(m, n);
+        // Opened without O_TRUNC so that an operand named again as the
+        // result is detected before anything is overwritten
+        FileDescriptor fileC(::open(pathC.c_str(), O_RDWR | O_CREAT, 0644));
+        if (fileC.fd < 0) {
+            std::cout << "Error: Cannot create matrix file " << pathC << "!\n";
+            return false;
+        }
+        if (sameFile(fileC.fd, fileA.fd) || sameFile(fileC.fd, fileB.fd)) {
+            std::cout << "Error: Result file " << pathC << " is also an operand of the multiplication!\n";
+            return false;
+        }
+        // Sized up front; the padding reads back as zeros
+        if (::ftruncate(fileC.fd, 0) != 0
+            || ::ftruncate(fileC.fd, MatrixFile::DATA_OFFSET + headerC.dataBytes) != 0) {
+            std::cout << "Error: Cannot create matrix file " << pathC << "!\n";
+            return false;
+        }
+
+        const int tilesI = (m + shape.rows - 1) / shape.rows;
+        const int tilesJ = (n + shape.cols - 1) / shape.cols;
+        const int tilesK = (k + shape.depth - 1) / shape.depth;
+        const long long steps = static_cast<long long>(tilesI) * tilesJ * tilesK;
+
+        BasicMatrix<T> tilesA[2] = {BasicMatrix<T>(shape.rows, shape.depth), BasicMatrix<T>(shape.rows, shape.depth)};
+        BasicMatrix<T> tilesB[2] = {BasicMatrix<T>(shape.depth, shape.cols), BasicMatrix<T>(shape.depth, shape.cols)};
+        BasicMatrix<Acc> tilesC[2] = {BasicMatrix<Acc>(shape.rows, shape.cols),
+                                      BasicMatrix<Acc>(shape.rows, shape.cols)};
+
+        // Step s multiplies A(i, kb) by B(kb, j); kb varies fastest
+        auto tileOf = [=](long long s, int& i0, int& j0, int& k0) {
+            i0 = static_cast<int>(s / (static_cast<long long>(tilesJ) * tilesK)) * shape.rows;
+            j0 = static_cast<int>(s / tilesK % tilesJ) * shape.cols;
+            k0 = static_cast<int>(s % tilesK) * shape.depth;
+        };
+        auto load = [&](long long s, int slot) {
+            int i0, j0, k0;
+            tileOf(s, i0, j0, k0);
+            return readTile(fileA.fd, headerA, tilesA[slot].block(0, 0, std::min(shape.rows, m - i0),
+                                                                  std::min(shape.depth, k - k0)), i0, k0)
+                   && readTile(fileB.fd, headerB, tilesB[slot].block(0, 0, std::min(shape.depth, k - k0),
+                                                                     std::min(shape.cols, n - j0)), k0, j0);
+        };
+
+        // Declared after the buffers so that on an early return they are
+        // waited for before the buffers go away
+        std::future<bool> reading = std::async(std::launch::async, load, 0LL, 0);
+        std::future<bool> writing;
+        int slotC = 0;
+        for (long long s = 0; s < steps; s++) {
+            const int slot = static_cast<int>(s & 1);
+            if (!reading.get()) {
+                std::cout << "Error: Failed to read a tile of " << pathA << " or " << pathB << "!\n";
+                return false;
+            }
+            if (s + 1 < steps) {
+                reading = std::async(std::launch::async, load, s + 1, slot ^ 1);
+            }
+
+            int i0, j0, k0;
+            tileOf(s, i0, j0, k0);
+            const int rows = std::min(shape.rows, m - i0);
+            const int cols = std::min(shape.cols, n - j0);
+            const int depth = std::min(shape.depth, k - k0);
+            const MatrixView<Acc> tile = tilesC[slotC].block(0, 0, rows, cols);
+            BasicMatrixOperations<T, Acc>::multiplyInto(tile, tilesA[slot].block(0, 0, rows, depth),
+                                                        tilesB[slot].block(0, 0, depth, cols),
+                                                        Acc(1), k0 == 0 ? Acc(0) : Acc(1), threads);
+            if (k0 + depth < k) {
+                continue;
+            }
+
+            // C tile complete: write it behind the next one
+            if (writing.valid() && !writing.get()) {
+                std::cout << "Error: Failed to write a tile of " << pathC << "!\n";
+                return false;
+            }
+            writing = std::async(std::launch::async, [&headerC, &fileC, tile, i0, j0]() {
+                return writeTile(fileC.fd, headerC, tile, i0, j0);
+            });
+            slotC ^= 1;
+        }
+        if (writing.valid() && !writing.get()) {
+            std::cout << "Error: Failed to write a tile of " << pathC << "!\n";
+            return false;
+        }
+
+        // The checksum runs over the data in file order, so it takes one
+        // sequential pass once every tile is in place
+        if (!checksumData(fileC.fd, headerC)
+            || !writeAll(fileC.fd, &headerC, sizeof(headerC), 0)) {
+            std::cout << "Error: Failed to write matrix file " << pathC << "!\n";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct FileDescriptor {
+        int fd;
+
+        explicit FileDescriptor(int descriptor) : fd(descriptor) {}
+        FileDescriptor(const FileDescriptor&) = delete;
+        FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+        ~FileDescriptor() {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    };
+
+    static bool sameFile(int fd1, int fd2) {
+        struct stat info1;
+        struct stat info2;
+        return ::fstat(fd1, &info1) == 0 && ::fstat(fd2, &info2) == 0 && info1.st_dev == info2.st_dev
+               && info1.st_ino == info2.st_ino;
+    }
+
+    static std::uint64_t elementOffset(const MatrixFileHeader& header, int row, int col, std::size_t size) {
+        return MatrixFile::DATA_OFFSET + (static_cast<std::uint64_t>(row) * header.stride + col) * size;
+    }
+
+    // Fill tile from the block of the file starting at (row, col)
+    static bool readTile(int fd, const MatrixFileHeader& header, const MatrixView<T>& tile, int row, int col) {
+        for (int i = 0; i < tile.getRows(); i++) {
+            if (!readAll(fd, tile.data() + i * tile.rowStride(), tile.getCols() * sizeof(T),
+                         elementOffset(header, row + i, col, sizeof(T)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool writeTile(int fd, const MatrixFileHeader& header, const ConstMatrixView<Acc>& tile, int row, int col) {
+        for (int i = 0; i < tile.getRows(); i++) {
+            if (!writeAll(fd, tile.data() + i * tile.rowStride(), tile.getCols() * sizeof(Acc),
+                          elementOffset(header, row + i, col, sizeof(Acc)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool checksumData(int fd, MatrixFileHeader& header) {
+        std::vector<char> chunk(MatrixFileWriter<Acc>::BUFFER_BYTES);
+        std::uint64_t hash = MatrixFile::CHECKSUM_SEED;
+        for (std::uint64_t done = 0; done < header.dataBytes;) {
+            const std::size_t bytes = static_cast<std::size_t>(
+                std::min<std::uint64_t>(chunk.size(), header.dataBytes - done));
+            if (!readAll(fd, chunk.data(), bytes, MatrixFile::DATA_OFFSET + done)) {
+                return false;
+            }
+            hash = MatrixFile::checksum(chunk.data(), bytes, hash);
+            done += bytes;
+        }
+        header.checksum = hash;
+        return true;
+    }
+
+    static bool readAll(int fd, void* data, std::size_t bytes, std::uint64_t offset) {
+        char* p = static_cast<char*>(data);
+        while (bytes > 0) {
+            const ssize_t got = ::pread(fd, p, bytes, static_cast<off_t>(offset));
+            if (got <= 0) {
+                if (got < 0 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            p += got;
+            bytes -= static_cast<std::size_t>(got);
+            offset += static_cast<std::uint64_t>(got);
+        }
+        return true;
+    }
+
+    static bool writeAll(int fd, const void* data, std::size_t bytes, std::uint64_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            const ssize_t put = ::pwrite(fd, p, bytes, static_cast<off_t>(offset));
+            if (put < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            p += put;
+            bytes -= static_cast<std::size_t>(put);
+            offset += static_cast<std::uint64_t>(put);
+        }
+        return true;
+    }
+};
+
+#endif // MATRIX_OUT_OF_CORE_H
@@ -0,0 +1,241 @@
+#ifndef MATRIX_RESULT_CACHE_H
+#define MATRIX_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "utility.h"
+
+// MatrixResultCache - memoizes operation results by operand content.
+//
+// A result is filed under the operation name, the operands' shapes and
+// content hashes (BasicMatrix::contentHash()) and an optional integer
+// parameter such as an exponent, so asking again for the product of
+// matrices with the same contents returns the stored copy instead of
+// recomputing it, whichever objects hold those contents. The cache keeps
+// at most capacityBytes of results and evicts the least recently used
+// first; results larger than that, and the empty results of failed
+// operations, are never stored.
+//
+// Lookups copy the stored result out, so caching pays for products,
+// powers, inverses and solves rather than for O(n^2) operations. Entries
+// are trusted on a hash match: two different operands colliding in 64
+// bits would return the wrong result. The cache is opt-in and thread
+// safe; concurrent misses on one key each compute and store the result.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+class MatrixResultCache {
+public:
+    typedef BasicMatrix<T> Matrix;
+    typedef BasicMatrixOperations<T, Acc> Operations;
+    typedef typename Operations::ProductMatrix ProductMatrix;
+    typedef typename Operations::RealMatrix RealMatrix;
+    typedef typename Operations::Determinant Determinant;
+
+    static constexpr std::size_t DEFAULT_CAPACITY_BYTES = std::size_t(64) << 20;
+
+    explicit MatrixResultCache(std::size_t capacityBytes = DEFAULT_CAPACITY_BYTES)
+        : capacity(capacityBytes), used(0), hitCount(0), missCount(0) {}
+
+    MatrixResultCache(const MatrixResultCache&) = delete;
+    MatrixResultCache& operator=(const MatrixResultCache&) = delete;
+
+    ProductMatrix multiply(const Matrix& matrix1, const Matrix& matrix2) {
+        return memoize<ProductMatrix>("multiply", matrix1, &matrix2, 0,
+                                      [&] { return Operations::multiply(matrix1, matrix2); });
+    }
+
+    ProductMatrix power(const Matrix& matrix1, int exponent) {
+        return memoize<ProductMatrix>("power", matrix1, nullptr, exponent,
+                                      [&] { return Operations::power(matrix1, exponent); });
+    }
+
+    RealMatrix inverse(const Matrix& matrix1) {
+        return memoize<RealMatrix>("inverse", matrix1, nullptr, 0, [&] { return Operations::inverse(matrix1); });
+    }
+
+    RealMatrix solve(const Matrix& matrix1, const Matrix& matrix2) {
+        return memoize<RealMatrix>("solve", matrix1, &matrix2, 0,
+                                   [&] { return Operations::solve(matrix1, matrix2); });
+    }
+
+    // A determinant that fails (non-square, or too large for an integer
+    // type) comes back as 0 like a singular one, so it is stored only when
+    // the computation reports success
+    Determinant determinant(const Matrix& matrix1) {
+        const Key key = makeKey("determinant", matrix1, nullptr, 0);
+        Determinant result = Determinant();
+        if (!lookup(key, result) && Operations::determinant(matrix1, result)) {
+            store(key, result);
+        }
+        return result;
+    }
+
+    // Any other operation: compute() runs on a miss. R must be the same
+    // type every time a given operation name is used. Only an empty matrix
+    // is recognised as a failure; any other R is always stored.
+    template <typename R, typename Compute>
+    R memoize(const std::string& operation, const Matrix& matrix1, const Matrix* matrix2, long long parameter,
+              Compute compute) {
+        const Key key = makeKey(operation, matrix1, matrix2, parameter);
+        {
+            R cached;
+            if (lookup(key, cached)) {
+                return cached;
+            }
+        }
+        R result = compute();
+        if (isCacheable(result)) {
+            store(key, result);
+        }
+        return result;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        index.clear();
+        used = 0;
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    // Bytes of results held
+    std::size_t bytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+
+    unsigned long long hits() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hitCount;
+    }
+
+    unsigned long long misses() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return missCount;
+    }
+
+private:
+    struct Key {
+        std::string operation;
+        std::uint64_t hash1;
+        std::uint64_t hash2; // 0 without a second operand
+        int rows1;
+        int cols1;
+        int rows2;
+        int cols2;
+        long long parameter;
+
+        bool operator==(const Key& other) const {
+            return operation == other.operation && hash1 == other.hash1 && hash2 == other.hash2
+                   && rows1 == other.rows1 && cols1 == other.cols1 && rows2 == other.rows2
+                   && cols2 == other.cols2 && parameter == other.parameter;
+        }
+    };
+
+    // The content hashes already cover the shapes
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const {
+            std::uint64_t hash = std::hash<std::string>()(key.operation);
+            hash = (hash ^ key.hash1) * 1099511628211ULL;
+            hash = (hash ^ key.hash2) * 1099511628211ULL;
+            hash = (hash ^ static_cast<std::uint64_t>(key.parameter)) * 1099511628211ULL;
+            return static_cast<std::size_t>(hash ^ (hash >> 32));
+        }
+    };
+
+    struct Entry {
+        Key key;
+        std::shared_ptr<const void> value;
+        std::size_t bytes;
+    };
+
+    // Most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, KeyHash> index;
+    mutable std::mutex mutex;
+    std::size_t capacity;
+    std::size_t used;
+    unsigned long long hitCount;
+    unsigned long long missCount;
+
+    static Key makeKey(const std::string& operation, const Matrix& matrix1, const Matrix* matrix2,
+                       long long parameter) {
+        Key key;
+        key.operation = operation;
+        key.hash1 = matrix1.contentHash();
+        key.hash2 = matrix2 != nullptr ? matrix2->contentHash() : 0;
+        key.rows1 = matrix1.getRows();
+        key.cols1 = matrix1.getCols();
+        key.rows2 = matrix2 != nullptr ? matrix2->getRows() : 0;
+        key.cols2 = matrix2 != nullptr ? matrix2->getCols() : 0;
+        key.parameter = parameter;
+        return key;
+    }
+
+    // Copy a stored result out, counting the hit or miss
+    template <typename R>
+    bool lookup(const Key& key, R& result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(key);
+        if (found == index.end()) {
+            missCount++;
+            return false;
+        }
+        hitCount++;
+        entries.splice(entries.begin(), entries, found->second);
+        result = *std::static_pointer_cast<const R>(found->second->value);
+        return true;
+    }
+
+    // File result under key unless it is larger than the whole cache
+    template <typename R>
+    void store(const Key& key, const R& result) {
+        const std::size_t bytes = bytesOf(result);
+        if (bytes > capacity) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index.find(key) == index.end()) {
+            entries.push_front(Entry{key, std::make_shared<const R>(result), bytes});
+            index[key] = entries.begin();
+            used += bytes;
+            while (used > capacity) {
+                used -= entries.back().bytes;
+                index.erase(entries.back().key);
+                entries.pop_back();
+            }
+        }
+    }
+
+    template <typename U>
+    static std::size_t bytesOf(const BasicMatrix<U>& matrix1) {
+        return static_cast<std::size_t>(matrix1.getRows()) * matrix1.stride() * sizeof(U);
+    }
+
+    template <typename R>
+    static std::size_t bytesOf(const R&) {
+        return sizeof(R);
+    }
+
+    template <typename U>
+    static bool isCacheable(const BasicMatrix<U>& matrix1) {
+        return !matrix1.isEmpty();
+    }
+
+    template <typename R>
+    static bool isCacheable(const R&) {
+        return true;
+    }
+};
+
+#endif // MATRIX_RESULT_CACHE_H
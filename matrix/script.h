@@ -0,0 +1,515 @@
+#ifndef MATRIX_SCRIPT_H
+#define MATRIX_SCRIPT_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "matrix_io.h"
+#include "matrix_writer.h"
+#include "utility.h"
+
+// MatrixScript - non-interactive interpreter for batches of operations on
+// named matrices, e.g.
+//
+//     A = load("a.mat"); B = read("b.txt")
+//     C = A * B; D = transpose(C) + 2 * C
+//     save(D, "d.mat"); print(equal(C, D))
+//
+// Statements end at ';' or a newline and '#' starts a comment. Operators
+// are + - and *, where * is a matrix product between matrices and a
+// scalar product when either side is a number. Built-ins:
+//
+//     load(path)  read(path)         binary (MatrixFile) / text input
+//     save(M, path)  write(M, path)  binary / text output
+//     print(x, ...)                  display matrices and numbers
+//     transpose(M)  identity(n)  zeros(r, c)  equal(A, B)  rows(M)  cols(M)
+//
+// Text files hold "rows cols" followed by the elements in row-major order.
+// Matrices are immutable once bound, so names share results instead of
+// copying them, and nothing is written unless a statement asks for it.
+// The first error is reported with its line number and stops the run.
+class MatrixScript {
+private:
+    struct Value {
+        enum Kind { NONE, NUMBER, TEXT, MATRIX };
+
+        Kind kind;
+        long long number;
+        std::string text;
+        std::shared_ptr<const Matrix> matrix;
+
+        Value() : kind(NONE), number(0) {}
+    };
+
+    struct Token {
+        enum Kind { NAME, NUMBER, TEXT, SYMBOL, END, EOF_TOKEN };
+
+        Kind kind;
+        std::string text;
+        long long number;
+        int line;
+    };
+
+    std::map<std::string, std::shared_ptr<const Matrix>> variables;
+    std::vector<Token> tokens;
+    std::size_t pos;
+    std::string error; // first error of the current statement
+
+public:
+    MatrixScript() : pos(0) {}
+
+    // Run a script; returns false after the first error
+    bool run(const std::string& source) {
+        tokens.clear();
+        pos = 0;
+        if (!tokenize(source)) {
+            return false;
+        }
+        while (peek().kind != Token::EOF_TOKEN) {
+            const int line = peek().line;
+            error.clear();
+            statement();
+            if (!error.empty()) {
+                std::cout << "Error: line " << line << ": " << error << "\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool runFile(const std::string& path) {
+        std::ifstream file(path.c_str());
+        if (!file) {
+            std::cout << "Error: Cannot open script " << path << "!\n";
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return run(buffer.str());
+    }
+
+    // Matrix bound to name, or null
+    std::shared_ptr<const Matrix> get(const std::string& name) const {
+        std::map<std::string, std::shared_ptr<const Matrix>>::const_iterator it = variables.find(name);
+        return it == variables.end() ? std::shared_ptr<const Matrix>() : it->second;
+    }
+
+    void set(const std::string& name, Matrix matrix) {
+        variables[name] = std::make_shared<const Matrix>(std::move(matrix));
+    }
+
+private:
+    bool tokenize(const std::string& source) {
+        int line = 1;
+        std::size_t i = 0;
+        while (i < source.size()) {
+            const char c = source[i];
+            Token token;
+            token.number = 0;
+            token.line = line;
+            if (c == '#') {
+                while (i < source.size() && source[i] != '\n') {
+                    i++;
+                }
+                continue;
+            }
+            if (c == '\n' || c == ';') {
+                token.kind = Token::END;
+                tokens.push_back(token);
+                line += c == '\n' ? 1 : 0;
+                i++;
+                continue;
+            }
+            if (std::isspace(static_cast<unsigned char>(c))) {
+                i++;
+                continue;
+            }
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                token.kind = Token::NUMBER;
+                while (i < source.size() && std::isdigit(static_cast<unsigned char>(source[i]))) {
+                    const long long digit = source[i] - '0';
+                    if (__builtin_mul_overflow(token.number, 10LL, &token.number)
+                        || __builtin_add_overflow(token.number, digit, &token.number)) {
+                        std::cout << "Error: line " << line << ": number too large\n";
+                        return false;
+                    }
+                    i++;
+                }
+            } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                token.kind = Token::NAME;
+                while (i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) {
+                    token.text += source[i++];
+                }
+            } else if (c == '"') {
+                token.kind = Token::TEXT;
+                for (i++; i < source.size() && source[i] != '"' && source[i] != '\n'; i++) {
+                    token.text += source[i];
+                }
+                if (i >= source.size() || source[i] != '"') {
+                    std::cout << "Error: line " << line << ": unterminated string\n";
+                    return false;
+                }
+                i++;
+            } else if (std::string("=+-*(),").find(c) != std::string::npos) {
+                token.kind = Token::SYMBOL;
+                token.text = std::string(1, c);
+                i++;
+            } else {
+                std::cout << "Error: line " << line << ": unexpected character '" << c << "'\n";
+                return false;
+            }
+            tokens.push_back(token);
+        }
+        Token eof;
+        eof.kind = Token::EOF_TOKEN;
+        eof.number = 0;
+        eof.line = line;
+        tokens.push_back(eof);
+        return true;
+    }
+
+    const Token& peek(std::size_t ahead = 0) const {
+        return tokens[std::min(pos + ahead, tokens.size() - 1)];
+    }
+
+    bool accept(const char* symbol) {
+        if (peek().kind == Token::SYMBOL && peek().text == symbol) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const char* symbol) {
+        if (!accept(symbol)) {
+            fail(std::string("expected '") + symbol + "'");
+        }
+    }
+
+    static std::string describe(const Token& token) {
+        switch (token.kind) {
+            case Token::NUMBER:
+                return "'" + std::to_string(token.number) + "'";
+            case Token::TEXT:
+                return "\"" + token.text + "\"";
+            case Token::END:
+            case Token::EOF_TOKEN:
+                return "end of statement";
+            default:
+                return "'" + token.text + "'";
+        }
+    }
+
+    // Record the first error; parsing functions return early once one is set
+    Value fail(const std::string& message) {
+        if (error.empty()) {
+            error = message;
+        }
+        return Value();
+    }
+
+    bool failed() const { return !error.empty(); }
+
+    // statement := [NAME '='] expr (END | EOF)
+    void statement() {
+        if (peek().kind == Token::END) {
+            pos++;
+            return;
+        }
+        if (peek().kind == Token::NAME && peek(1).kind == Token::SYMBOL && peek(1).text == "=") {
+            const std::string name = peek().text;
+            pos += 2;
+            Value value = expression();
+            if (failed()) {
+                return;
+            }
+            if (value.kind != Value::MATRIX) {
+                fail("only matrices can be assigned to '" + name + "'");
+                return;
+            }
+            variables[name] = value.matrix;
+        } else {
+            expression();
+        }
+        if (failed()) {
+            return;
+        }
+        if (peek().kind == Token::END) {
+            pos++;
+        } else if (peek().kind != Token::EOF_TOKEN) {
+            fail("unexpected " + describe(peek()));
+        }
+    }
+
+    // expr := term (('+' | '-') term)*
+    Value expression() {
+        Value left = term();
+        while (!failed() && peek().kind == Token::SYMBOL && (peek().text == "+" || peek().text == "-")) {
+            const char op = tokens[pos++].text[0];
+            Value right = term();
+            if (failed()) {
+                break;
+            }
+            left = combine(op, left, right);
+        }
+        return left;
+    }
+
+    // term := unary ('*' unary)*
+    Value term() {
+        Value left = unary();
+        while (!failed() && accept("*")) {
+            Value right = unary();
+            if (failed()) {
+                break;
+            }
+            left = combine('*', left, right);
+        }
+        return left;
+    }
+
+    // unary := '-' unary | primary
+    Value unary() {
+        if (accept("-")) {
+            Value operand = unary();
+            return failed() ? Value() : combine('*', number(-1), operand);
+        }
+        return primary();
+    }
+
+    // primary := NUMBER | TEXT | NAME | NAME '(' args ')' | '(' expr ')'
+    Value primary() {
+        const Token token = peek();
+        if (token.kind == Token::NUMBER) {
+            pos++;
+            return number(token.number);
+        }
+        if (token.kind == Token::TEXT) {
+            pos++;
+            Value value;
+            value.kind = Value::TEXT;
+            value.text = token.text;
+            return value;
+        }
+        if (accept("(")) {
+            Value value = expression();
+            expect(")");
+            return value;
+        }
+        if (token.kind != Token::NAME) {
+            return fail("unexpected " + describe(token));
+        }
+        pos++;
+        if (!accept("(")) {
+            std::shared_ptr<const Matrix> matrix = get(token.text);
+            if (!matrix) {
+                return fail("unknown matrix '" + token.text + "'");
+            }
+            Value value;
+            value.kind = Value::MATRIX;
+            value.matrix = matrix;
+            return value;
+        }
+        std::vector<Value> args;
+        if (!accept(")")) {
+            do {
+                args.push_back(expression());
+            } while (!failed() && accept(","));
+            expect(")");
+        }
+        return failed() ? Value() : call(token.text, args);
+    }
+
+    static Value number(long long n) {
+        Value value;
+        value.kind = Value::NUMBER;
+        value.number = n;
+        return value;
+    }
+
+    // The operation has already printed why it produced an empty matrix
+    Value matrix(Matrix m) {
+        if (m.isEmpty()) {
+            return fail("operation failed");
+        }
+        Value value;
+        value.kind = Value::MATRIX;
+        value.matrix = std::make_shared<const Matrix>(std::move(m));
+        return value;
+    }
+
+    Value combine(char op, const Value& left, const Value& right) {
+        if (left.kind == Value::NUMBER && right.kind == Value::NUMBER) {
+            long long result = 0;
+            const bool overflow = op == '+' ? __builtin_add_overflow(left.number, right.number, &result)
+                                  : op == '-' ? __builtin_sub_overflow(left.number, right.number, &result)
+                                  : __builtin_mul_overflow(left.number, right.number, &result);
+            return overflow ? fail(std::string("number too large in '") + op + "'") : number(result);
+        }
+        if (left.kind == Value::MATRIX && right.kind == Value::MATRIX) {
+            if (op == '+') {
+                return matrix(MatrixOperations::add(*left.matrix, *right.matrix));
+            }
+            if (op == '-') {
+                return matrix(MatrixOperations::subtract(*left.matrix, *right.matrix));
+            }
+            return matrix(MatrixOperations::multiply(*left.matrix, *right.matrix));
+        }
+        if (op == '*' && left.kind == Value::NUMBER && right.kind == Value::MATRIX) {
+            if (!fitsInt(left)) {
+                return Value();
+            }
+            return matrix(MatrixOperations::scalarMultiply(*right.matrix, static_cast<int>(left.number)));
+        }
+        if (op == '*' && left.kind == Value::MATRIX && right.kind == Value::NUMBER) {
+            if (!fitsInt(right)) {
+                return Value();
+            }
+            return matrix(MatrixOperations::scalarMultiply(*left.matrix, static_cast<int>(right.number)));
+        }
+        return fail(std::string("invalid operands for '") + op + "'");
+    }
+
+    // Numbers reach matrix operations as int; anything wider is an error
+    bool fitsInt(const Value& value) {
+        if (value.number < std::numeric_limits<int>::min() || value.number > std::numeric_limits<int>::max()) {
+            fail("number " + std::to_string(value.number) + " is out of range");
+            return false;
+        }
+        return true;
+    }
+
+    bool checkArgs(const std::string& name, const std::vector<Value>& args, const char* kinds) {
+        const std::string expected(kinds);
+        bool ok = args.size() == expected.size();
+        for (std::size_t i = 0; ok && i < args.size(); i++) {
+            const Value::Kind kind = expected[i] == 'm' ? Value::MATRIX
+                                     : expected[i] == 'n' ? Value::NUMBER : Value::TEXT;
+            ok = args[i].kind == kind;
+        }
+        if (!ok) {
+            std::string usage;
+            for (std::size_t i = 0; i < expected.size(); i++) {
+                usage += (i ? ", " : "");
+                usage += expected[i] == 'm' ? "matrix" : expected[i] == 'n' ? "number" : "\"path\"";
+            }
+            fail("usage: " + name + "(" + usage + ")");
+        }
+        return ok;
+    }
+
+    Value call(const std::string& name, const std::vector<Value>& args) {
+        if (name == "load") {
+            if (!checkArgs(name, args, "t")) {
+                return Value();
+            }
+            return matrix(MatrixFile::load<int>(args[0].text));
+        }
+        if (name == "read") {
+            if (!checkArgs(name, args, "t")) {
+                return Value();
+            }
+            Matrix result = readText(args[0].text);
+            return result.isEmpty() ? fail("cannot read a matrix from " + args[0].text) : matrix(std::move(result));
+        }
+        if (name == "save") {
+            if (!checkArgs(name, args, "mt")) {
+                return Value();
+            }
+            return MatrixFile::save(args[1].text, *args[0].matrix) ? Value() : fail("cannot save " + args[1].text);
+        }
+        if (name == "write") {
+            if (!checkArgs(name, args, "mt")) {
+                return Value();
+            }
+            return writeText(args[1].text, *args[0].matrix) ? Value() : fail("cannot write " + args[1].text);
+        }
+        if (name == "print") {
+            for (std::size_t i = 0; i < args.size(); i++) {
+                if (args[i].kind == Value::MATRIX) {
+                    args[i].matrix->displayMatrix();
+                } else if (args[i].kind == Value::NUMBER) {
+                    std::cout << args[i].number << "\n";
+                } else if (args[i].kind == Value::TEXT) {
+                    std::cout << args[i].text << "\n";
+                }
+            }
+            return Value();
+        }
+        if (name == "transpose") {
+            if (!checkArgs(name, args, "m")) {
+                return Value();
+            }
+            return matrix(MatrixOperations::transpose(*args[0].matrix));
+        }
+        if (name == "identity") {
+            if (!checkArgs(name, args, "n") || !fitsInt(args[0])) {
+                return Value();
+            }
+            return matrix(MatrixOperations::createIdentityMatrix(static_cast<int>(args[0].number)));
+        }
+        if (name == "zeros") {
+            if (!checkArgs(name, args, "nn") || !fitsInt(args[0]) || !fitsInt(args[1])) {
+                return Value();
+            }
+            return matrix(Matrix(static_cast<int>(args[0].number), static_cast<int>(args[1].number)));
+        }
+        if (name == "equal") {
+            if (!checkArgs(name, args, "mm")) {
+                return Value();
+            }
+            return number(MatrixOperations::isEqual(*args[0].matrix, *args[1].matrix) ? 1 : 0);
+        }
+        if (name == "rows" || name == "cols") {
+            if (!checkArgs(name, args, "m")) {
+                return Value();
+            }
+            return number(name == "rows" ? args[0].matrix->getRows() : args[0].matrix->getCols());
+        }
+        return fail("unknown function '" + name + "'");
+    }
+
+    static Matrix readText(const std::string& path) {
+        std::ifstream file(path.c_str());
+        int rows = 0;
+        int cols = 0;
+        if (!file || !(file >> rows >> cols) || rows <= 0 || cols <= 0) {
+            return Matrix();
+        }
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; i++) {
+            int* row = result.data() + static_cast<std::size_t>(i) * result.stride();
+            for (int j = 0; j < cols; j++) {
+                if (!(file >> row[j])) {
+                    return Matrix();
+                }
+            }
+        }
+        return result;
+    }
+
+    static bool writeText(const std::string& path, const Matrix& matrix1) {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            return false;
+        }
+        // Space-separated without a trailing delimiter, after a "rows cols" line
+        MatrixWriter writer(file, MatrixTextFormat::Csv);
+        writer.setDelimiter(" ");
+        writer.write(std::to_string(matrix1.getRows()) + " " + std::to_string(matrix1.getCols()) + "\n");
+        writer.write(matrix1.view());
+        const bool written = writer.flush();
+        return std::fclose(file) == 0 && written;
+    }
+};
+
+#endif // MATRIX_SCRIPT_H
@@ -0,0 +1,306 @@
+#ifndef MATRIX_SIMD_H
+#define MATRIX_SIMD_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MATRIX_SIMD_X86 1
+#define MATRIX_TARGET(isa) __attribute__((target(isa)))
+#define MATRIX_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define MATRIX_TARGET(isa)
+#define MATRIX_ALWAYS_INLINE inline
+#endif
+
+// Instruction set levels the elementwise kernels are built for
+enum class SimdLevel {
+    Scalar,
+    Sse42,
+    Avx2,
+    Avx512
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Sse42:  return "sse4.2";
+        case SimdLevel::Avx2:   return "avx2";
+        case SimdLevel::Avx512: return "avx512";
+        default:                return "scalar";
+    }
+}
+
+// ScalarLoops - portable one-element-at-a-time kernels, the fallback on
+// every platform
+template <typename T>
+struct ScalarLoops {
+    static void add(const T* a, const T* b, T* c, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            c[i] = static_cast<T>(a[i] + b[i]);
+        }
+    }
+
+    static void subtract(const T* a, const T* b, T* c, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            c[i] = static_cast<T>(a[i] - b[i]);
+        }
+    }
+
+    static void scale(const T* a, T scalar, T* c, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            c[i] = static_cast<T>(a[i] * scalar);
+        }
+    }
+
+    static void multiplyAdd(const T* a, const T* b, T* c, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            c[i] = static_cast<T>(c[i] + a[i] * b[i]);
+        }
+    }
+
+    static bool equal(const T* a, const T* b, std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            if (a[i] != b[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#if defined(MATRIX_SIMD_X86)
+// VectorLoops - kernels written with GCC vector extensions for a register
+// width of Bytes. They are force-inlined into the per-ISA wrappers below,
+// so 16-, 32- and 64-byte vectors turn into SSE, AVX2 and AVX-512
+// instructions respectively, for whatever element type T is.
+template <typename T, int Bytes>
+struct VectorLoops {
+    typedef T Vec __attribute__((vector_size(Bytes)));
+    static constexpr std::size_t LANES = Bytes / sizeof(T);
+
+    // Vectors are passed by reference: these helpers are always inlined, and
+    // by-value vector arguments would trip GCC's ABI warnings
+    static MATRIX_ALWAYS_INLINE void load(Vec& v, const T* p) {
+        std::memcpy(&v, p, sizeof(v));
+    }
+
+    static MATRIX_ALWAYS_INLINE void store(T* p, const Vec& v) {
+        std::memcpy(p, &v, sizeof(v));
+    }
+
+    // Comparison results are integer lane masks (all ones where true)
+    template <typename Mask>
+    static MATRIX_ALWAYS_INLINE bool isZero(const Mask& v) {
+        unsigned long long words[sizeof(Mask) / sizeof(unsigned long long)];
+        std::memcpy(words, &v, sizeof(v));
+        unsigned long long any = 0;
+        for (std::size_t k = 0; k < sizeof(Mask) / sizeof(unsigned long long); k++) {
+            any |= words[k];
+        }
+        return any == 0;
+    }
+
+    static MATRIX_ALWAYS_INLINE void add(const T* a, const T* b, T* c, std::size_t n) {
+        std::size_t i = 0;
+        Vec va, vb;
+        for (; i + LANES <= n; i += LANES) {
+            load(va, a + i);
+            load(vb, b + i);
+            store(c + i, va + vb);
+        }
+        for (; i < n; i++) {
+            c[i] = static_cast<T>(a[i] + b[i]);
+        }
+    }
+
+    static MATRIX_ALWAYS_INLINE void subtract(const T* a, const T* b, T* c, std::size_t n) {
+        std::size_t i = 0;
+        Vec va, vb;
+        for (; i + LANES <= n; i += LANES) {
+            load(va, a + i);
+            load(vb, b + i);
+            store(c + i, va - vb);
+        }
+        for (; i < n; i++) {
+            c[i] = static_cast<T>(a[i] - b[i]);
+        }
+    }
+
+    static MATRIX_ALWAYS_INLINE void scale(const T* a, T scalar, T* c, std::size_t n) {
+        const Vec s = Vec{} + scalar;
+        std::size_t i = 0;
+        Vec va;
+        for (; i + LANES <= n; i += LANES) {
+            load(va, a + i);
+            store(c + i, va * s);
+        }
+        for (; i < n; i++) {
+            c[i] = static_cast<T>(a[i] * scalar);
+        }
+    }
+
+    static MATRIX_ALWAYS_INLINE void multiplyAdd(const T* a, const T* b, T* c, std::size_t n) {
+        std::size_t i = 0;
+        Vec va, vb, vc;
+        for (; i + LANES <= n; i += LANES) {
+            load(va, a + i);
+            load(vb, b + i);
+            load(vc, c + i);
+            store(c + i, vc + va * vb);
+        }
+        for (; i < n; i++) {
+            c[i] = static_cast<T>(c[i] + a[i] * b[i]);
+        }
+    }
+
+    // ORs the lane masks of four vector compares together and leaves on the
+    // first group that differs. Comparing with != (not bitwise) keeps
+    // floating-point semantics: -0.0 equals 0.0 and NaN equals nothing.
+    static MATRIX_ALWAYS_INLINE bool equal(const T* a, const T* b, std::size_t n) {
+        typedef decltype(Vec{} != Vec{}) Mask;
+        std::size_t i = 0;
+        Vec va, vb;
+        for (; i + 4 * LANES <= n; i += 4 * LANES) {
+            Mask diff = Mask{};
+            for (std::size_t u = 0; u < 4; u++) {
+                load(va, a + i + u * LANES);
+                load(vb, b + i + u * LANES);
+                diff |= va != vb;
+            }
+            if (!isZero(diff)) {
+                return false;
+            }
+        }
+        for (; i + LANES <= n; i += LANES) {
+            load(va, a + i);
+            load(vb, b + i);
+            Mask diff = va != vb;
+            if (!isZero(diff)) {
+                return false;
+            }
+        }
+        for (; i < n; i++) {
+            if (a[i] != b[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+#endif
+
+// ElementwiseKernels - one function table per element type and
+// instruction set level
+template <typename T>
+struct ElementwiseKernels {
+    void (*add)(const T*, const T*, T*, std::size_t);
+    void (*subtract)(const T*, const T*, T*, std::size_t);
+    void (*scale)(const T*, T, T*, std::size_t);
+    void (*multiplyAdd)(const T*, const T*, T*, std::size_t); // c += a * b
+    bool (*equal)(const T*, const T*, std::size_t);
+    SimdLevel level;
+};
+
+#define MATRIX_DEFINE_ELEMENTWISE_KERNELS(Name, isa, bytes)                                \
+    template <typename T>                                                                   \
+    struct Name {                                                                           \
+        MATRIX_TARGET(isa) static void add(const T* a, const T* b, T* c, std::size_t n) {   \
+            VectorLoops<T, bytes>::add(a, b, c, n);                                         \
+        }                                                                                   \
+        MATRIX_TARGET(isa) static void subtract(const T* a, const T* b, T* c,               \
+                                                std::size_t n) {                            \
+            VectorLoops<T, bytes>::subtract(a, b, c, n);                                    \
+        }                                                                                   \
+        MATRIX_TARGET(isa) static void scale(const T* a, T s, T* c, std::size_t n) {        \
+            VectorLoops<T, bytes>::scale(a, s, c, n);                                       \
+        }                                                                                   \
+        MATRIX_TARGET(isa) static void multiplyAdd(const T* a, const T* b, T* c,            \
+                                                   std::size_t n) {                         \
+            VectorLoops<T, bytes>::multiplyAdd(a, b, c, n);                                 \
+        }                                                                                   \
+        MATRIX_TARGET(isa) static bool equal(const T* a, const T* b, std::size_t n) {       \
+            return VectorLoops<T, bytes>::equal(a, b, n);                                   \
+        }                                                                                   \
+    };
+
+#if defined(MATRIX_SIMD_X86)
+MATRIX_DEFINE_ELEMENTWISE_KERNELS(Sse42Kernels, "sse4.2", 16)
+MATRIX_DEFINE_ELEMENTWISE_KERNELS(Avx2Kernels, "avx2", 32)
+MATRIX_DEFINE_ELEMENTWISE_KERNELS(Avx512Kernels, "avx512f,avx512bw", 64)
+#endif
+
+// SimdDispatch - picks the best kernel table for each element type once,
+// at first use
+//
+// The choice comes from CPUID; setting MATRIX_SIMD to scalar, sse4.2, avx2
+// or avx512 caps it, which is handy for comparing kernels on one machine.
+class SimdDispatch {
+public:
+    template <typename T>
+    static const ElementwiseKernels<T>& kernels() {
+        static const ElementwiseKernels<T>& selected = kernelsFor<T>(level());
+        return selected;
+    }
+
+    // Level chosen for this process
+    static SimdLevel level() {
+        static const SimdLevel selected = detect();
+        return selected;
+    }
+
+    // Highest level supported by both the CPU and the MATRIX_SIMD cap
+    static SimdLevel detect() {
+        SimdLevel level = SimdLevel::Scalar;
+#if defined(MATRIX_SIMD_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+            level = SimdLevel::Avx512;
+        } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            level = SimdLevel::Avx2;
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            level = SimdLevel::Sse42;
+        }
+#endif
+        const char* cap = std::getenv("MATRIX_SIMD");
+        if (cap != nullptr) {
+            for (SimdLevel l : { SimdLevel::Scalar, SimdLevel::Sse42, SimdLevel::Avx2, SimdLevel::Avx512 }) {
+                if (std::strcmp(cap, simdLevelName(l)) == 0 && l < level) {
+                    level = l;
+                }
+            }
+        }
+        return level;
+    }
+
+    // Kernel table for a given level; the caller must make sure the CPU
+    // supports it
+    template <typename T>
+    static const ElementwiseKernels<T>& kernelsFor(SimdLevel level) {
+        static const ElementwiseKernels<T> scalar = makeTable<T, ScalarLoops<T>>(SimdLevel::Scalar);
+#if defined(MATRIX_SIMD_X86)
+        static const ElementwiseKernels<T> sse42 = makeTable<T, Sse42Kernels<T>>(SimdLevel::Sse42);
+        static const ElementwiseKernels<T> avx2 = makeTable<T, Avx2Kernels<T>>(SimdLevel::Avx2);
+        static const ElementwiseKernels<T> avx512 = makeTable<T, Avx512Kernels<T>>(SimdLevel::Avx512);
+        switch (level) {
+            case SimdLevel::Sse42:  return sse42;
+            case SimdLevel::Avx2:   return avx2;
+            case SimdLevel::Avx512: return avx512;
+            default:                break;
+        }
+#else
+        (void)level;
+#endif
+        return scalar;
+    }
+
+private:
+    template <typename T, typename K>
+    static ElementwiseKernels<T> makeTable(SimdLevel level) {
+        ElementwiseKernels<T> table = { &K::add, &K::subtract, &K::scale, &K::multiplyAdd, &K::equal, level };
+        return table;
+    }
+};
+
+#endif // MATRIX_SIMD_H
@@ -0,0 +1,454 @@
+#ifndef MATRIX_SPARSE_H
+#define MATRIX_SPARSE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "thread_pool.h"
+#include "utility.h"
+
+template <typename T, typename Acc>
+class SparseOperations;
+
+// Storage order of a compressed sparse matrix
+enum class SparseFormat {
+    Csr, // compressed rows: outer index runs over rows
+    Csc  // compressed columns: outer index runs over columns
+};
+
+// SparseMatrix - compressed sparse row / column storage.
+//
+// Nonzeros of outer line k (a row for CSR, a column for CSC) are
+// values[outer[k] .. outer[k + 1]) with their inner coordinates in
+// inner[...], sorted ascending and free of duplicates and explicit zeros.
+// Memory is O(rows + nnz) instead of O(rows * cols).
+template <typename T>
+class SparseMatrix {
+private:
+    int rows;
+    int cols;
+    SparseFormat storage;
+    std::vector<std::size_t> outer;
+    std::vector<int> inner;
+    std::vector<T> values;
+
+    int outerSize() const { return storage == SparseFormat::Csr ? rows : cols; }
+    int innerSize() const { return storage == SparseFormat::Csr ? cols : rows; }
+
+public:
+    typedef T value_type;
+
+    SparseMatrix(int r = 0, int c = 0, SparseFormat format = SparseFormat::Csr)
+        : rows(r > 0 && c > 0 ? r : 0), cols(r > 0 && c > 0 ? c : 0), storage(format),
+          outer(static_cast<std::size_t>(outerSize()) + 1, 0) {}
+
+    // Nonzeros of a dense matrix
+    static SparseMatrix fromDense(const BasicMatrix<T>& dense, SparseFormat format = SparseFormat::Csr) {
+        SparseMatrix result(dense.getRows(), dense.getCols(), SparseFormat::Csr);
+        for (int i = 0; i < result.rows; i++) {
+            const T* row = dense.data() + static_cast<std::size_t>(i) * dense.stride();
+            for (int j = 0; j < result.cols; j++) {
+                if (row[j] != T()) {
+                    result.inner.push_back(j);
+                    result.values.push_back(row[j]);
+                }
+            }
+            result.outer[i + 1] = result.values.size();
+        }
+        return format == SparseFormat::Csr ? result : result.toCsc();
+    }
+
+    BasicMatrix<T> toDense() const {
+        BasicMatrix<T> result(rows, cols);
+        T* base = result.data();
+        const std::size_t ld = static_cast<std::size_t>(result.stride());
+        for (int k = 0; k < outerSize(); k++) {
+            for (std::size_t p = outer[k]; p < outer[k + 1]; p++) {
+                if (storage == SparseFormat::Csr) {
+                    base[k * ld + inner[p]] = values[p];
+                } else {
+                    base[inner[p] * ld + k] = values[p];
+                }
+            }
+        }
+        return result;
+    }
+
+    SparseMatrix toCsr() const {
+        return storage == SparseFormat::Csr ? *this : switchFormat();
+    }
+
+    SparseMatrix toCsc() const {
+        return storage == SparseFormat::Csc ? *this : switchFormat();
+    }
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    SparseFormat format() const { return storage; }
+    std::size_t nonZeros() const { return values.size(); }
+    bool isEmpty() const { return rows == 0 || cols == 0; }
+
+    double density() const {
+        return isEmpty() ? 0.0 : static_cast<double>(values.size()) / (static_cast<double>(rows) * cols);
+    }
+
+    const std::vector<std::size_t>& outerIndex() const { return outer; }
+    const std::vector<int>& innerIndex() const { return inner; }
+    const std::vector<T>& nonZeroValues() const { return values; }
+
+    // Get element at specific position (binary search within its line)
+    T getElement(int row, int col) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+            return T();
+        }
+        const int k = storage == SparseFormat::Csr ? row : col;
+        const int target = storage == SparseFormat::Csr ? col : row;
+        const int* first = inner.data() + outer[k];
+        const int* last = inner.data() + outer[k + 1];
+        const int* hit = std::lower_bound(first, last, target);
+        return (hit != last && *hit == target) ? values[hit - inner.data()] : T();
+    }
+
+    void displayMatrix() const {
+        std::cout << "Sparse matrix (" << rows << "x" << cols << ", " << values.size() << " nonzeros, "
+                  << (storage == SparseFormat::Csr ? "CSR" : "CSC") << ")\n";
+        toDense().displayMatrix();
+    }
+
+private:
+    // CSR <-> CSC by counting sort over the inner index; inner indices of
+    // the result come out sorted because the source is walked in order
+    SparseMatrix switchFormat() const {
+        SparseMatrix result(rows, cols, storage == SparseFormat::Csr ? SparseFormat::Csc : SparseFormat::Csr);
+        const int newOuter = innerSize();
+        for (int idx : inner) {
+            result.outer[idx + 1]++;
+        }
+        for (int k = 0; k < newOuter; k++) {
+            result.outer[k + 1] += result.outer[k];
+        }
+        result.inner.resize(values.size());
+        result.values.resize(values.size());
+        std::vector<std::size_t> next(result.outer.begin(), result.outer.end() - 1);
+        for (int k = 0; k < outerSize(); k++) {
+            for (std::size_t p = outer[k]; p < outer[k + 1]; p++) {
+                const std::size_t q = next[inner[p]]++;
+                result.inner[q] = k;
+                result.values[q] = values[p];
+            }
+        }
+        return result;
+    }
+
+    template <typename U>
+    friend class CooMatrix;
+
+    template <typename U, typename A>
+    friend class SparseOperations;
+};
+
+// CooMatrix - coordinate (triplet) list used to assemble a SparseMatrix.
+// Entries may come in any order; duplicates are summed when compressing.
+template <typename T>
+class CooMatrix {
+private:
+    struct Entry {
+        int row;
+        int col;
+        T value;
+    };
+
+    int rows;
+    int cols;
+    std::vector<Entry> entries;
+
+public:
+    CooMatrix(int r, int c) : rows(r > 0 && c > 0 ? r : 0), cols(r > 0 && c > 0 ? c : 0) {}
+
+    void reserve(std::size_t count) { entries.reserve(count); }
+
+    // Out-of-range coordinates are ignored, like BasicMatrix::setElement
+    void add(int row, int col, T value) {
+        if (row >= 0 && row < rows && col >= 0 && col < cols) {
+            Entry e = { row, col, value };
+            entries.push_back(e);
+        }
+    }
+
+    std::size_t size() const { return entries.size(); }
+
+    SparseMatrix<T> compress(SparseFormat format = SparseFormat::Csr) const {
+        const bool byRow = format == SparseFormat::Csr;
+        std::vector<Entry> sorted(entries);
+        std::sort(sorted.begin(), sorted.end(), [byRow](const Entry& x, const Entry& y) {
+            const int xo = byRow ? x.row : x.col;
+            const int yo = byRow ? y.row : y.col;
+            if (xo != yo) {
+                return xo < yo;
+            }
+            return (byRow ? x.col : x.row) < (byRow ? y.col : y.row);
+        });
+
+        SparseMatrix<T> result(rows, cols, format);
+        std::size_t i = 0;
+        while (i < sorted.size()) {
+            const int o = byRow ? sorted[i].row : sorted[i].col;
+            const int in = byRow ? sorted[i].col : sorted[i].row;
+            T sum = T();
+            for (; i < sorted.size() && (byRow ? sorted[i].row : sorted[i].col) == o
+                   && (byRow ? sorted[i].col : sorted[i].row) == in; i++) {
+                sum = static_cast<T>(sum + sorted[i].value);
+            }
+            if (sum != T()) {
+                result.inner.push_back(in);
+                result.values.push_back(sum);
+                result.outer[o + 1]++;
+            }
+        }
+        for (std::size_t k = 1; k < result.outer.size(); k++) {
+            result.outer[k] += result.outer[k - 1];
+        }
+        return result;
+    }
+};
+
+// SparseOperations - sparse kernels, mirroring MatrixOperations.
+//
+// All kernels work on CSR (CSC operands are converted first) and split the
+// output rows into chunks on the shared ThreadPool; each output row is
+// written by exactly one task, so results do not depend on the thread
+// count. Small problems run on the calling thread.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+class SparseOperations {
+public:
+    typedef BasicMatrix<T> Matrix;
+    typedef BasicMatrix<Acc> ProductMatrix;
+
+    // Matrices with a smaller fraction of nonzeros are multiplied sparsely
+    // by multiplyAuto()
+    static constexpr double DENSITY_THRESHOLD = 0.05;
+
+    // Work (nonzeros touched) below which kernels stay single-threaded
+    static constexpr std::size_t PARALLEL_WORK = 1 << 16;
+
+    // Fraction of nonzero elements
+    static double density(const Matrix& matrix1) {
+        if (matrix1.isEmpty()) {
+            return 0.0;
+        }
+        std::size_t count = 0;
+        for (int i = 0; i < matrix1.getRows(); i++) {
+            const T* row = matrix1.data() + static_cast<std::size_t>(i) * matrix1.stride();
+            for (int j = 0; j < matrix1.getCols(); j++) {
+                count += row[j] != T() ? 1 : 0;
+            }
+        }
+        return static_cast<double>(count) / (static_cast<double>(matrix1.getRows()) * matrix1.getCols());
+    }
+
+    // y = A x
+    static std::vector<Acc> multiply(const SparseMatrix<T>& matrix1, const std::vector<T>& vector1) {
+        if (static_cast<std::size_t>(matrix1.cols) != vector1.size()) {
+            std::cout << "Error: Matrix columns must equal vector length for multiplication!\n";
+            return std::vector<Acc>();
+        }
+        const SparseMatrix<T> a = matrix1.toCsr();
+        std::vector<Acc> result(static_cast<std::size_t>(a.rows), Acc());
+        forRowChunks(a.rows, a.nonZeros(), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                Acc sum = Acc();
+                for (std::size_t p = a.outer[i]; p < a.outer[i + 1]; p++) {
+                    sum += static_cast<Acc>(a.values[p]) * static_cast<Acc>(vector1[a.inner[p]]);
+                }
+                result[i] = sum;
+            }
+        });
+        return result;
+    }
+
+    // Sparse x dense: each nonzero a(i, k) adds a(i, k) * B[k, :] to row i
+    static ProductMatrix multiply(const SparseMatrix<T>& matrix1, const Matrix& matrix2) {
+        if (matrix1.cols != matrix2.getRows()) {
+            reportShapes(matrix1.rows, matrix1.cols, matrix2.getRows(), matrix2.getCols());
+            return ProductMatrix();
+        }
+        const SparseMatrix<T> a = matrix1.toCsr();
+        const int n = matrix2.getCols();
+        ProductMatrix result(a.rows, n);
+        forRowChunks(a.rows, a.nonZeros() * static_cast<std::size_t>(n), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                Acc* c = result.data() + static_cast<std::size_t>(i) * result.stride();
+                for (std::size_t p = a.outer[i]; p < a.outer[i + 1]; p++) {
+                    const Acc v = static_cast<Acc>(a.values[p]);
+                    const T* b = matrix2.data() + static_cast<std::size_t>(a.inner[p]) * matrix2.stride();
+                    for (int j = 0; j < n; j++) {
+                        c[j] += v * static_cast<Acc>(b[j]);
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+    // Dense x sparse: row i of the result accumulates A[i, k] * B[k, :]
+    // over the nonzeros of each row k of B
+    static ProductMatrix multiply(const Matrix& matrix1, const SparseMatrix<T>& matrix2) {
+        if (matrix1.getCols() != matrix2.rows) {
+            reportShapes(matrix1.getRows(), matrix1.getCols(), matrix2.rows, matrix2.cols);
+            return ProductMatrix();
+        }
+        const SparseMatrix<T> b = matrix2.toCsr();
+        const int m = matrix1.getRows();
+        ProductMatrix result(m, b.cols);
+        forRowChunks(m, b.nonZeros() * static_cast<std::size_t>(m), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const T* a = matrix1.data() + static_cast<std::size_t>(i) * matrix1.stride();
+                Acc* c = result.data() + static_cast<std::size_t>(i) * result.stride();
+                for (int k = 0; k < b.rows; k++) {
+                    if (a[k] == T()) {
+                        continue;
+                    }
+                    const Acc v = static_cast<Acc>(a[k]);
+                    for (std::size_t p = b.outer[k]; p < b.outer[k + 1]; p++) {
+                        c[b.inner[p]] += v * static_cast<Acc>(b.values[p]);
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+    // Sparse x sparse (Gustavson). A symbolic pass counts the nonzeros of
+    // every output row so the result arrays are allocated once; a numeric
+    // pass then scatters each row into a dense accumulator indexed by
+    // column and gathers the touched columns back in sorted order.
+    static SparseMatrix<Acc> multiply(const SparseMatrix<T>& matrix1, const SparseMatrix<T>& matrix2) {
+        if (matrix1.cols != matrix2.rows) {
+            reportShapes(matrix1.rows, matrix1.cols, matrix2.rows, matrix2.cols);
+            return SparseMatrix<Acc>();
+        }
+        const SparseMatrix<T> a = matrix1.toCsr();
+        const SparseMatrix<T> b = matrix2.toCsr();
+        SparseMatrix<Acc> result(a.rows, b.cols, SparseFormat::Csr);
+        if (result.isEmpty()) {
+            return result;
+        }
+
+        std::size_t work = 0;
+        for (int k : a.inner) {
+            work += b.outer[k + 1] - b.outer[k];
+        }
+
+        forRowChunks(a.rows, work, [&](int begin, int end) {
+            std::vector<int> marker(static_cast<std::size_t>(b.cols), -1);
+            for (int i = begin; i < end; i++) {
+                std::size_t count = 0;
+                for (std::size_t p = a.outer[i]; p < a.outer[i + 1]; p++) {
+                    const int k = a.inner[p];
+                    for (std::size_t q = b.outer[k]; q < b.outer[k + 1]; q++) {
+                        if (marker[b.inner[q]] != i) {
+                            marker[b.inner[q]] = i;
+                            count++;
+                        }
+                    }
+                }
+                result.outer[i + 1] = count;
+            }
+        });
+
+        for (int i = 0; i < a.rows; i++) {
+            result.outer[i + 1] += result.outer[i];
+        }
+        result.inner.resize(result.outer[a.rows]);
+        result.values.resize(result.outer[a.rows]);
+
+        forRowChunks(a.rows, work, [&](int begin, int end) {
+            std::vector<Acc> accumulator(static_cast<std::size_t>(b.cols), Acc());
+            std::vector<int> marker(static_cast<std::size_t>(b.cols), -1);
+            for (int i = begin; i < end; i++) {
+                int* cols = result.inner.data() + result.outer[i];
+                std::size_t count = 0;
+                for (std::size_t p = a.outer[i]; p < a.outer[i + 1]; p++) {
+                    const Acc v = static_cast<Acc>(a.values[p]);
+                    const int k = a.inner[p];
+                    for (std::size_t q = b.outer[k]; q < b.outer[k + 1]; q++) {
+                        const int j = b.inner[q];
+                        if (marker[j] != i) {
+                            marker[j] = i;
+                            cols[count++] = j;
+                            accumulator[j] = Acc();
+                        }
+                        accumulator[j] += v * static_cast<Acc>(b.values[q]);
+                    }
+                }
+                std::sort(cols, cols + count);
+                Acc* vals = result.values.data() + result.outer[i];
+                for (std::size_t c = 0; c < count; c++) {
+                    vals[c] = accumulator[cols[c]];
+                }
+            }
+        });
+
+        dropZeros(result);
+        return result;
+    }
+
+    // Dense product that switches to the sparse x dense kernel when the
+    // left operand is sparse enough to make it worthwhile
+    static ProductMatrix multiplyAuto(const Matrix& matrix1, const Matrix& matrix2) {
+        if (matrix1.getCols() == matrix2.getRows() && density(matrix1) < DENSITY_THRESHOLD) {
+            return multiply(SparseMatrix<T>::fromDense(matrix1), matrix2);
+        }
+        return BasicMatrixOperations<T, Acc>::multiply(matrix1, matrix2);
+    }
+
+private:
+    static void reportShapes(int rows1, int cols1, int rows2, int cols2) {
+        std::cout << "Error: First matrix columns must equal second matrix rows for multiplication!\n";
+        std::cout << "Matrix 1: " << rows1 << "x" << cols1 << "\n";
+        std::cout << "Matrix 2: " << rows2 << "x" << cols2 << "\n";
+    }
+
+    // body(begin, end) over row chunks; parallel once the work is large
+    template <typename Body>
+    static void forRowChunks(int rows, std::size_t work, const Body& body) {
+        if (rows <= 0) {
+            return;
+        }
+        if (work < PARALLEL_WORK) {
+            body(0, rows);
+            return;
+        }
+        ThreadPool& pool = ThreadPool::instance();
+        const int chunks = std::min(rows, 4 * pool.size());
+        pool.parallelFor(chunks, 0, [&](int t) {
+            const int begin = static_cast<int>(static_cast<long long>(rows) * t / chunks);
+            const int end = static_cast<int>(static_cast<long long>(rows) * (t + 1) / chunks);
+            body(begin, end);
+        });
+    }
+
+    // Cancellation can leave explicit zeros behind; squeeze them out
+    static void dropZeros(SparseMatrix<Acc>& m) {
+        std::size_t write = 0;
+        std::size_t start = 0;
+        for (int k = 0; k < m.rows; k++) {
+            const std::size_t end = m.outer[k + 1];
+            for (std::size_t p = start; p < end; p++) {
+                if (m.values[p] != Acc()) {
+                    m.inner[write] = m.inner[p];
+                    m.values[write] = m.values[p];
+                    write++;
+                }
+            }
+            start = end;
+            m.outer[k + 1] = write;
+        }
+        m.inner.resize(write);
+        m.values.resize(write);
+    }
+};
+
+#endif // MATRIX_SPARSE_H
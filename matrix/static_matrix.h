@@ -0,0 +1,144 @@
+#ifndef MATRIX_STATIC_MATRIX_H
+#define MATRIX_STATIC_MATRIX_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// StaticMatrix - fixed-size matrix with inline storage for small shapes
+// (transforms and the like).
+//
+// Elements sit in a std::array, so there is no heap allocation, and every
+// operation is constexpr. Loops over element indices are expanded at
+// compile time with index sequences, so a 4x4 product is straight-line
+// code the optimizer can vectorize freely. Conversions to and from
+// BasicMatrix live in utility.h.
+template <int R, int C, typename T = int>
+class StaticMatrix {
+    static_assert(R > 0 && C > 0, "StaticMatrix dimensions must be positive");
+
+public:
+    typedef T value_type;
+    static constexpr int ROWS = R;
+    static constexpr int COLS = C;
+
+private:
+    std::array<T, static_cast<std::size_t>(R * C)> elements;
+
+    template <std::size_t... I>
+    static constexpr StaticMatrix addImpl(const StaticMatrix& a, const StaticMatrix& b,
+                                          std::index_sequence<I...>) {
+        return StaticMatrix(std::array<T, sizeof...(I)>{ { static_cast<T>(a.elements[I] + b.elements[I])... } });
+    }
+
+    template <std::size_t... I>
+    static constexpr StaticMatrix subtractImpl(const StaticMatrix& a, const StaticMatrix& b,
+                                               std::index_sequence<I...>) {
+        return StaticMatrix(std::array<T, sizeof...(I)>{ { static_cast<T>(a.elements[I] - b.elements[I])... } });
+    }
+
+    template <std::size_t... I>
+    static constexpr StaticMatrix scaleImpl(const StaticMatrix& a, T s, std::index_sequence<I...>) {
+        return StaticMatrix(std::array<T, sizeof...(I)>{ { static_cast<T>(a.elements[I] * s)... } });
+    }
+
+    template <std::size_t... I>
+    static constexpr StaticMatrix identityImpl(std::index_sequence<I...>) {
+        return StaticMatrix(std::array<T, sizeof...(I)>{ { T(I / C == I % C ? 1 : 0)... } });
+    }
+
+    // Element I of the transpose (C x R) is element (I % R, I / R) here
+    template <std::size_t... I>
+    constexpr StaticMatrix<C, R, T> transposeImpl(std::index_sequence<I...>) const {
+        return StaticMatrix<C, R, T>(std::array<T, sizeof...(I)>{ { elements[(I % R) * C + I / R]... } });
+    }
+
+    template <int K, std::size_t... P>
+    static constexpr T dot(const StaticMatrix& a, const StaticMatrix<C, K, T>& b,
+                           std::size_t i, std::size_t j, std::index_sequence<P...>) {
+        T sum = T();
+        ((sum += a.elements[i * C + P] * b(static_cast<int>(P), static_cast<int>(j))), ...);
+        return sum;
+    }
+
+    template <int K, std::size_t... I>
+    static constexpr StaticMatrix<R, K, T> multiplyImpl(const StaticMatrix& a, const StaticMatrix<C, K, T>& b,
+                                                        std::index_sequence<I...>) {
+        return StaticMatrix<R, K, T>(std::array<T, sizeof...(I)>{
+            { dot<K>(a, b, I / K, I % K, std::make_index_sequence<C>())... } });
+    }
+
+public:
+    // Zero matrix
+    constexpr StaticMatrix() : elements() {}
+
+    // Row-major element list, e.g. StaticMatrix<2, 2>({ 1, 2, 3, 4 })
+    constexpr explicit StaticMatrix(const std::array<T, static_cast<std::size_t>(R * C)>& values)
+        : elements(values) {}
+
+    static constexpr StaticMatrix identity() {
+        static_assert(R == C, "identity requires a square StaticMatrix");
+        return identityImpl(std::make_index_sequence<R * C>());
+    }
+
+    constexpr int getRows() const { return R; }
+    constexpr int getCols() const { return C; }
+
+    // Unchecked access
+    constexpr T operator()(int i, int j) const { return elements[static_cast<std::size_t>(i * C + j)]; }
+    constexpr T& operator()(int i, int j) { return elements[static_cast<std::size_t>(i * C + j)]; }
+
+    // Bounds-checked access, matching BasicMatrix
+    constexpr T getElement(int row, int col) const {
+        return (row >= 0 && row < R && col >= 0 && col < C) ? (*this)(row, col) : T();
+    }
+
+    constexpr void setElement(int row, int col, T value) {
+        if (row >= 0 && row < R && col >= 0 && col < C) {
+            (*this)(row, col) = value;
+        }
+    }
+
+    constexpr const T* data() const { return elements.data(); }
+    constexpr T* data() { return elements.data(); }
+
+    constexpr StaticMatrix<C, R, T> transpose() const {
+        return transposeImpl(std::make_index_sequence<R * C>());
+    }
+
+    friend constexpr StaticMatrix operator+(const StaticMatrix& a, const StaticMatrix& b) {
+        return addImpl(a, b, std::make_index_sequence<R * C>());
+    }
+
+    friend constexpr StaticMatrix operator-(const StaticMatrix& a, const StaticMatrix& b) {
+        return subtractImpl(a, b, std::make_index_sequence<R * C>());
+    }
+
+    friend constexpr StaticMatrix operator*(T s, const StaticMatrix& a) {
+        return scaleImpl(a, s, std::make_index_sequence<R * C>());
+    }
+
+    friend constexpr StaticMatrix operator*(const StaticMatrix& a, T s) {
+        return scaleImpl(a, s, std::make_index_sequence<R * C>());
+    }
+
+    template <int K>
+    friend constexpr StaticMatrix<R, K, T> operator*(const StaticMatrix& a, const StaticMatrix<C, K, T>& b) {
+        return multiplyImpl<K>(a, b, std::make_index_sequence<R * K>());
+    }
+
+    friend constexpr bool operator==(const StaticMatrix& a, const StaticMatrix& b) {
+        for (std::size_t i = 0; i < a.elements.size(); i++) {
+            if (a.elements[i] != b.elements[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend constexpr bool operator!=(const StaticMatrix& a, const StaticMatrix& b) {
+        return !(a == b);
+    }
+};
+
+#endif // MATRIX_STATIC_MATRIX_H
@@ -0,0 +1,183 @@
+#ifndef MATRIX_STRASSEN_H
+#define MATRIX_STRASSEN_H
+
+#include <cstddef>
+
+#include "gemm.h"
+#include "simd.h"
+
+// StrassenWorkspace - scratch memory for StrassenMultiply, reusable across
+// calls. It only ever grows, so a workspace kept alive by the caller makes
+// repeated products of the same size allocation free.
+class StrassenWorkspace {
+private:
+    AlignedBuffer<unsigned char> buffer;
+
+public:
+    // Room for count elements of T
+    template <typename T>
+    T* reserve(std::size_t count) {
+        buffer.resize(count * sizeof(T));
+        return reinterpret_cast<T*>(buffer.get());
+    }
+
+    // Capacity in bytes
+    std::size_t capacity() const { return buffer.size(); }
+};
+
+// StrassenMultiply - Strassen-Winograd product of square matrices.
+//
+// Each level splits the operands into h x h quadrants and forms the result
+// from 7 half-size products and 15 additions, using the schedule of Douglas
+// et al. (1994) that needs only two h x h temporaries: everything else is
+// staged in the quadrants of C. Odd orders are handled by dynamic peeling:
+// the leading even block recurses and the last row and column are fixed up
+// with thin products. Below the crossover the blocked GEMM kernel takes
+// over. Integer arithmetic makes the result exact; floating-point results
+// differ from the classical product by rounding only.
+class StrassenMultiply {
+public:
+    // Orders at or below this go straight to the blocked kernel
+    static constexpr int DEFAULT_CROSSOVER = 512;
+
+    // Scratch elements needed for an order-n product
+    static std::size_t workspaceSize(int n, int crossover) {
+        std::size_t total = 0;
+        while (n > crossover && n >= 2) {
+            const std::size_t h = static_cast<std::size_t>(n / 2);
+            total += 2 * h * h;
+            n /= 2;
+        }
+        return total;
+    }
+
+    // C (n x n) = A (n x n) * B (n x n); all row-major with the given strides
+    template <typename T>
+    static void multiply(int n, const T* a, std::ptrdiff_t lda,
+                         const T* b, std::ptrdiff_t ldb,
+                         T* c, std::ptrdiff_t ldc,
+                         int crossover, StrassenWorkspace& workspace) {
+        if (crossover < 16) {
+            crossover = 16;
+        }
+        T* scratch = workspace.reserve<T>(workspaceSize(n, crossover));
+        recurse(n, a, lda, b, ldb, c, ldc, crossover, scratch);
+    }
+
+private:
+    // Z = X op Y over an h x h block, one SIMD kernel call per row. Z may be
+    // the same block as X or Y.
+    template <typename T>
+    static void blockOp(void (*kernel)(const T*, const T*, T*, std::size_t), int h,
+                        const T* x, std::ptrdiff_t ldx,
+                        const T* y, std::ptrdiff_t ldy,
+                        T* z, std::ptrdiff_t ldz) {
+        for (int i = 0; i < h; i++) {
+            kernel(x + i * ldx, y + i * ldy, z + i * ldz, static_cast<std::size_t>(h));
+        }
+    }
+
+    template <typename T>
+    static void recurse(int n, const T* a, std::ptrdiff_t lda,
+                        const T* b, std::ptrdiff_t ldb,
+                        T* c, std::ptrdiff_t ldc,
+                        int crossover, T* scratch) {
+        if (n <= crossover || n < 2) {
+            GemmKernel<T>::multiplyParallel(n, n, n, a, lda, 1, b, ldb, 1, c, ldc, 0, 0);
+            return;
+        }
+        if (n % 2 != 0) {
+            peel(n, a, lda, b, ldb, c, ldc, crossover, scratch);
+            return;
+        }
+
+        const int h = n / 2;
+        const ElementwiseKernels<T>& k = SimdDispatch::kernels<T>();
+
+        const T* a11 = a;
+        const T* a12 = a + h;
+        const T* a21 = a + h * lda;
+        const T* a22 = a + h * lda + h;
+        const T* b11 = b;
+        const T* b12 = b + h;
+        const T* b21 = b + h * ldb;
+        const T* b22 = b + h * ldb + h;
+        T* c11 = c;
+        T* c12 = c + h;
+        T* c21 = c + h * ldc;
+        T* c22 = c + h * ldc + h;
+
+        const std::ptrdiff_t ldw = h;
+        T* x = scratch;
+        T* y = scratch + static_cast<std::size_t>(h) * h;
+        T* deeper = y + static_cast<std::size_t>(h) * h;
+
+        blockOp(k.subtract, h, a11, lda, a21, lda, x, ldw);                 // S3 = A11 - A21
+        blockOp(k.subtract, h, b22, ldb, b12, ldb, y, ldw);                 // T3 = B22 - B12
+        recurse(h, x, ldw, y, ldw, c21, ldc, crossover, deeper);           // P7 = S3 T3
+        blockOp(k.add, h, a21, lda, a22, lda, x, ldw);                      // S1 = A21 + A22
+        blockOp(k.subtract, h, b12, ldb, b11, ldb, y, ldw);                 // T1 = B12 - B11
+        recurse(h, x, ldw, y, ldw, c22, ldc, crossover, deeper);           // P5 = S1 T1
+        blockOp(k.subtract, h, x, ldw, a11, lda, x, ldw);                   // S2 = S1 - A11
+        blockOp(k.subtract, h, b22, ldb, y, ldw, y, ldw);                   // T2 = B22 - T1
+        recurse(h, x, ldw, y, ldw, c12, ldc, crossover, deeper);           // P6 = S2 T2
+        blockOp(k.subtract, h, a12, lda, x, ldw, x, ldw);                   // S4 = A12 - S2
+        recurse(h, x, ldw, b22, ldb, c11, ldc, crossover, deeper);         // P3 = S4 B22
+        recurse(h, a11, lda, b11, ldb, x, ldw, crossover, deeper);         // P1 = A11 B11
+        blockOp(k.add, h, x, ldw, c12, ldc, c12, ldc);                      // U2 = P1 + P6
+        blockOp(k.add, h, c12, ldc, c21, ldc, c21, ldc);                    // U3 = U2 + P7
+        blockOp(k.add, h, c12, ldc, c22, ldc, c12, ldc);                    // U4 = U2 + P5
+        blockOp(k.add, h, c21, ldc, c22, ldc, c22, ldc);                    // U7 = U3 + P5 -> C22
+        blockOp(k.add, h, c12, ldc, c11, ldc, c12, ldc);                    // U5 = U4 + P3 -> C12
+        blockOp(k.subtract, h, y, ldw, b21, ldb, y, ldw);                   // T4 = T2 - B21
+        recurse(h, a22, lda, y, ldw, c11, ldc, crossover, deeper);         // P4 = A22 T4
+        blockOp(k.subtract, h, c21, ldc, c11, ldc, c21, ldc);               // U6 = U3 - P4 -> C21
+        recurse(h, a12, lda, b21, ldb, c11, ldc, crossover, deeper);       // P2 = A12 B21
+        blockOp(k.add, h, x, ldw, c11, ldc, c11, ldc);                      // U1 = P1 + P2 -> C11
+    }
+
+    // Odd n = m + 1: recurse on the leading m x m block, then add the
+    // rank-1 term from the peeled column of A and row of B, and compute the
+    // last column and last row of C directly
+    template <typename T>
+    static void peel(int n, const T* a, std::ptrdiff_t lda,
+                     const T* b, std::ptrdiff_t ldb,
+                     T* c, std::ptrdiff_t ldc,
+                     int crossover, T* scratch) {
+        const int m = n - 1;
+        recurse(m, a, lda, b, ldb, c, ldc, crossover, scratch);
+
+        const T* bLast = b + m * ldb;
+        for (int i = 0; i < m; i++) {
+            const T aim = a[i * lda + m];
+            T* ci = c + i * ldc;
+            for (int j = 0; j < m; j++) {
+                ci[j] += aim * bLast[j];
+            }
+        }
+
+        for (int i = 0; i < m; i++) {
+            const T* ai = a + i * lda;
+            T sum = T();
+            for (int p = 0; p < n; p++) {
+                sum += ai[p] * b[p * ldb + m];
+            }
+            c[i * ldc + m] = sum;
+        }
+
+        const T* aLast = a + m * lda;
+        T* cLast = c + m * ldc;
+        for (int j = 0; j < n; j++) {
+            cLast[j] = T();
+        }
+        for (int p = 0; p < n; p++) {
+            const T ap = aLast[p];
+            const T* bp = b + p * ldb;
+            for (int j = 0; j < n; j++) {
+                cLast[j] += ap * bp[j];
+            }
+        }
+    }
+};
+
+#endif // MATRIX_STRASSEN_H
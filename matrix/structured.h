@@ -0,0 +1,543 @@
+#ifndef MATRIX_STRUCTURED_H
+#define MATRIX_STRUCTURED_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.h"
+#include "utility.h"
+
+template <typename T, typename Acc>
+class StructuredOperations;
+
+// Shapes a StructuredMatrix can take
+enum class MatrixStructure {
+    Identity,        // nothing stored
+    Diagonal,        // n values
+    Banded,          // n * (lower + upper + 1) values
+    UpperTriangular, // n (n + 1) / 2 values, packed by rows
+    LowerTriangular
+};
+
+inline const char* matrixStructureName(MatrixStructure structure) {
+    switch (structure) {
+        case MatrixStructure::Identity:        return "identity";
+        case MatrixStructure::Diagonal:        return "diagonal";
+        case MatrixStructure::Banded:          return "banded";
+        case MatrixStructure::UpperTriangular: return "upper triangular";
+        default:                               return "lower triangular";
+    }
+}
+
+// StructuredMatrix - square matrices whose nonzeros lie in a band.
+//
+// Every structure is described by its lower and upper bandwidth: row i may
+// hold nonzeros in columns i - lower .. i + upper and nothing else is
+// stored. A diagonal is the band (0, 0), a triangle the band (0, n - 1) or
+// (n - 1, 0); the identity stores nothing at all. Factories normalize the
+// band, so banded(n, 0, n - 1) comes back upper triangular. Each row's
+// stored entries are contiguous, which is what StructuredOperations
+// relies on to turn products into short row updates.
+template <typename T>
+class StructuredMatrix {
+private:
+    MatrixStructure kind;
+    int n;
+    int lower;
+    int upper;
+    std::vector<T> values;
+
+    template <typename U, typename A>
+    friend class StructuredOperations;
+    template <typename U>
+    friend class StructuredMatrix;
+
+    StructuredMatrix(MatrixStructure structure, int size, int lowerBand, int upperBand)
+        : kind(structure), n(size > 0 ? size : 0), lower(lowerBand), upper(upperBand) {
+        std::size_t count = 0;
+        switch (kind) {
+            case MatrixStructure::Identity:        count = 0; break;
+            case MatrixStructure::Diagonal:        count = n; break;
+            case MatrixStructure::Banded:          count = static_cast<std::size_t>(n) * (lower + upper + 1); break;
+            case MatrixStructure::UpperTriangular:
+            case MatrixStructure::LowerTriangular: count = static_cast<std::size_t>(n) * (n + 1) / 2; break;
+        }
+        values.assign(count, T());
+    }
+
+    // The narrowest structure holding bands (lowerBand, upperBand)
+    static StructuredMatrix withBands(int size, int lowerBand, int upperBand) {
+        lowerBand = std::max(0, std::min(lowerBand, size - 1));
+        upperBand = std::max(0, std::min(upperBand, size - 1));
+        if (lowerBand == 0 && upperBand == 0) {
+            return StructuredMatrix(MatrixStructure::Diagonal, size, 0, 0);
+        }
+        if (lowerBand == 0 && upperBand == size - 1) {
+            return StructuredMatrix(MatrixStructure::UpperTriangular, size, 0, upperBand);
+        }
+        if (upperBand == 0 && lowerBand == size - 1) {
+            return StructuredMatrix(MatrixStructure::LowerTriangular, size, lowerBand, 0);
+        }
+        return StructuredMatrix(MatrixStructure::Banded, size, lowerBand, upperBand);
+    }
+
+    int firstCol(int i) const { return std::max(0, i - lower); }
+    int lastCol(int i) const { return std::min(n - 1, i + upper); }
+
+    // Stored entries of row i: rowData(i)[j - firstCol(i)]; not for Identity
+    const T* rowData(int i) const {
+        switch (kind) {
+            case MatrixStructure::Diagonal:
+                return values.data() + i;
+            case MatrixStructure::Banded:
+                return values.data() + static_cast<std::size_t>(i) * (lower + upper + 1) + (firstCol(i) - i + lower);
+            case MatrixStructure::UpperTriangular:
+                return values.data() + static_cast<std::size_t>(i) * n - static_cast<std::size_t>(i) * (i - 1) / 2;
+            default:
+                return values.data() + static_cast<std::size_t>(i) * (i + 1) / 2;
+        }
+    }
+
+    T* rowData(int i) { return const_cast<T*>(static_cast<const StructuredMatrix&>(*this).rowData(i)); }
+
+    bool inBand(int i, int j) const { return j >= firstCol(i) && j <= lastCol(i); }
+
+    // f(j, value) for every stored entry of row i, in column order
+    template <typename F>
+    void forRow(int i, const F& f) const {
+        if (kind == MatrixStructure::Identity) {
+            f(i, T(1));
+            return;
+        }
+        const T* row = rowData(i);
+        const int first = firstCol(i);
+        const int last = lastCol(i);
+        for (int j = first; j <= last; j++) {
+            f(j, row[j - first]);
+        }
+    }
+
+    T diagonalEntry(int i) const { return kind == MatrixStructure::Identity ? T(1) : rowData(i)[i - firstCol(i)]; }
+
+public:
+    typedef T value_type;
+
+    StructuredMatrix() : kind(MatrixStructure::Identity), n(0), lower(0), upper(0) {}
+
+    static StructuredMatrix identity(int size) {
+        return StructuredMatrix(MatrixStructure::Identity, size, 0, 0);
+    }
+
+    static StructuredMatrix diagonal(const std::vector<T>& entries) {
+        StructuredMatrix result(MatrixStructure::Diagonal, static_cast<int>(entries.size()), 0, 0);
+        result.values = entries;
+        return result;
+    }
+
+    // Zero band matrix; fill it with setElement()
+    static StructuredMatrix banded(int size, int lowerBand, int upperBand) {
+        if (lowerBand < 0 || upperBand < 0) {
+            std::cout << "Error: Bandwidths must be non-negative!\n";
+            return StructuredMatrix();
+        }
+        return withBands(size, lowerBand, upperBand);
+    }
+
+    static StructuredMatrix upperTriangular(int size) { return withBands(size, 0, size - 1); }
+    static StructuredMatrix lowerTriangular(int size) { return withBands(size, size - 1, 0); }
+
+    // The band (lowerBand, upperBand) of a square dense matrix; entries
+    // outside it are dropped
+    static StructuredMatrix fromDense(const BasicMatrix<T>& dense, int lowerBand, int upperBand) {
+        if (dense.getRows() != dense.getCols() || dense.isEmpty()) {
+            std::cout << "Error: Structured matrices must be square!\n";
+            return StructuredMatrix();
+        }
+        StructuredMatrix result = banded(dense.getRows(), lowerBand, upperBand);
+        for (int i = 0; i < result.n; i++) {
+            const T* row = dense.data() + static_cast<std::size_t>(i) * dense.stride();
+            const int first = result.firstCol(i);
+            std::copy(row + first, row + result.lastCol(i) + 1, result.rowData(i));
+        }
+        return result;
+    }
+
+    BasicMatrix<T> toDense() const {
+        BasicMatrix<T> result(n, n);
+        for (int i = 0; i < n; i++) {
+            T* row = result.data() + static_cast<std::size_t>(i) * result.stride();
+            forRow(i, [row](int j, T value) { row[j] = value; });
+        }
+        return result;
+    }
+
+    int getRows() const { return n; }
+    int getCols() const { return n; }
+    bool isEmpty() const { return n == 0; }
+    MatrixStructure structure() const { return kind; }
+    int lowerBandwidth() const { return lower; }
+    int upperBandwidth() const { return upper; }
+    std::size_t storedElements() const { return values.size(); }
+
+    T getElement(int row, int col) const {
+        if (row < 0 || row >= n || col < 0 || col >= n || !inBand(row, col)) {
+            return T();
+        }
+        if (kind == MatrixStructure::Identity) {
+            return T(1);
+        }
+        return rowData(row)[col - firstCol(row)];
+    }
+
+    // Only entries inside the structure can be set
+    void setElement(int row, int col, T value) {
+        if (kind == MatrixStructure::Identity || row < 0 || row >= n || col < 0 || col >= n || !inBand(row, col)) {
+            std::cout << "Error: Element (" << row << ", " << col << ") is outside the structure of this "
+                      << matrixStructureName(kind) << " matrix!\n";
+            return;
+        }
+        rowData(row)[col - firstCol(row)] = value;
+    }
+
+    void displayMatrix() const {
+        std::cout << "Structured matrix (" << n << "x" << n << ", " << matrixStructureName(kind) << ", "
+                  << values.size() << " stored elements)\n";
+        toDense().displayMatrix();
+    }
+};
+
+// StructuredOperations - arithmetic that exploits structure.
+//
+// Products with a dense matrix touch only the stored band: identity * A is
+// a copy, diagonal * A scales rows, A * diagonal scales columns and a band
+// of width w costs O(n w) per dense column instead of O(n^2). Structured
+// operands combine into the narrowest structure that holds the result
+// (the product of bands (l1, u1) and (l2, u2) has band (l1 + l2, u1 + u2)),
+// so chains of structured factors stay structured. Triangular and
+// diagonal systems are solved by substitution and general bands by a
+// banded LU in O(n l (l + u)), so no operation here converts to dense.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+class StructuredOperations {
+public:
+    typedef BasicMatrix<T> Matrix;
+    typedef BasicMatrix<Acc> ProductMatrix;
+    typedef StructuredMatrix<T> Structured;
+    typedef typename RealTraits<T>::type Real;
+    typedef typename DeterminantTraits<T>::type Determinant;
+
+    // Multiply-adds below which a product stays on the calling thread
+    static constexpr std::size_t PARALLEL_WORK = 1 << 16;
+
+    static ProductMatrix multiply(const Structured& matrix1, const Matrix& matrix2) {
+        if (matrix1.n != matrix2.getRows()) {
+            reportShapes(matrix1.n, matrix1.n, matrix2.getRows(), matrix2.getCols());
+            return ProductMatrix();
+        }
+        if (matrix1.kind == MatrixStructure::Identity) {
+            return convert<Acc>(matrix2);
+        }
+        const int cols = matrix2.getCols();
+        ProductMatrix result(matrix1.n, cols);
+        // Row i of the result combines the rows of matrix2 its band selects
+        forRowChunks(matrix1.n, matrix1.values.size() * static_cast<std::size_t>(cols), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                Acc* c = result.data() + static_cast<std::size_t>(i) * result.stride();
+                matrix1.forRow(i, [&](int k, T value) {
+                    const Acc v = static_cast<Acc>(value);
+                    const T* b = matrix2.data() + static_cast<std::size_t>(k) * matrix2.stride();
+                    for (int j = 0; j < cols; j++) {
+                        c[j] += v * static_cast<Acc>(b[j]);
+                    }
+                });
+            }
+        });
+        return result;
+    }
+
+    static ProductMatrix multiply(const Matrix& matrix1, const Structured& matrix2) {
+        if (matrix1.getCols() != matrix2.n) {
+            reportShapes(matrix1.getRows(), matrix1.getCols(), matrix2.n, matrix2.n);
+            return ProductMatrix();
+        }
+        if (matrix2.kind == MatrixStructure::Identity) {
+            return convert<Acc>(matrix1);
+        }
+        const int n = matrix2.n;
+        ProductMatrix result(matrix1.getRows(), n);
+        forRowChunks(matrix1.getRows(), matrix2.values.size() * static_cast<std::size_t>(matrix1.getRows()),
+                     [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                const T* a = matrix1.data() + static_cast<std::size_t>(i) * matrix1.stride();
+                Acc* c = result.data() + static_cast<std::size_t>(i) * result.stride();
+                if (matrix2.kind == MatrixStructure::Diagonal) {
+                    const T* d = matrix2.values.data();
+                    for (int j = 0; j < n; j++) {
+                        c[j] = static_cast<Acc>(a[j]) * static_cast<Acc>(d[j]);
+                    }
+                    continue;
+                }
+                // Row k of matrix2 contributes a[k] times its band segment
+                for (int k = 0; k < n; k++) {
+                    const Acc v = static_cast<Acc>(a[k]);
+                    const T* b = matrix2.rowData(k);
+                    Acc* ck = c + matrix2.firstCol(k);
+                    const int width = matrix2.lastCol(k) - matrix2.firstCol(k) + 1;
+                    for (int j = 0; j < width; j++) {
+                        ck[j] += v * static_cast<Acc>(b[j]);
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+    static StructuredMatrix<Acc> multiply(const Structured& matrix1, const Structured& matrix2) {
+        if (matrix1.n != matrix2.n) {
+            reportShapes(matrix1.n, matrix1.n, matrix2.n, matrix2.n);
+            return StructuredMatrix<Acc>();
+        }
+        if (matrix1.kind == MatrixStructure::Identity) {
+            return convert<Acc>(matrix2);
+        }
+        if (matrix2.kind == MatrixStructure::Identity) {
+            return convert<Acc>(matrix1);
+        }
+        StructuredMatrix<Acc> result = StructuredMatrix<Acc>::withBands(
+            matrix1.n, matrix1.lower + matrix2.lower, matrix1.upper + matrix2.upper);
+        for (int i = 0; i < result.n; i++) {
+            Acc* c = result.rowData(i) - result.firstCol(i);
+            matrix1.forRow(i, [&](int k, T a) {
+                const Acc v = static_cast<Acc>(a);
+                matrix2.forRow(k, [&](int j, T b) { c[j] += v * static_cast<Acc>(b); });
+            });
+        }
+        return result;
+    }
+
+    static Structured add(const Structured& matrix1, const Structured& matrix2) {
+        return combine(matrix1, matrix2, T(1), "addition");
+    }
+
+    static Structured subtract(const Structured& matrix1, const Structured& matrix2) {
+        return combine(matrix1, matrix2, static_cast<T>(-1), "subtraction");
+    }
+
+    // A dense sum is dense; only the band is added to the copy
+    static Matrix add(const Structured& matrix1, const Matrix& matrix2) {
+        if (matrix1.n != matrix2.getRows() || matrix1.n != matrix2.getCols()) {
+            std::cout << "Error: Matrices must have same dimensions for addition!\n";
+            return Matrix();
+        }
+        Matrix result(matrix2);
+        for (int i = 0; i < matrix1.n; i++) {
+            T* row = result.data() + static_cast<std::size_t>(i) * result.stride();
+            matrix1.forRow(i, [row](int j, T value) { row[j] = static_cast<T>(row[j] + value); });
+        }
+        return result;
+    }
+
+    static Structured scalarMultiply(const Structured& matrix1, T scalar) {
+        if (matrix1.kind == MatrixStructure::Identity) {
+            return Structured::diagonal(std::vector<T>(static_cast<std::size_t>(matrix1.n), scalar));
+        }
+        Structured result(matrix1);
+        for (T& value : result.values) {
+            value = static_cast<T>(value * scalar);
+        }
+        return result;
+    }
+
+    static Structured transpose(const Structured& matrix1) {
+        if (matrix1.kind == MatrixStructure::Identity || matrix1.kind == MatrixStructure::Diagonal) {
+            return matrix1;
+        }
+        Structured result = Structured::withBands(matrix1.n, matrix1.upper, matrix1.lower);
+        for (int i = 0; i < matrix1.n; i++) {
+            matrix1.forRow(i, [&](int j, T value) { result.rowData(j)[i - result.firstCol(j)] = value; });
+        }
+        return result;
+    }
+
+    // X with matrix1 X = matrix2. Bands with no lower (or no upper) part
+    // are solved by back (or forward) substitution over the band, general
+    // bands by a banded LU (LuKernel::bandFactor), so nothing is made dense.
+    static BasicMatrix<Real> solve(const Structured& matrix1, const Matrix& matrix2) {
+        if (matrix1.n != matrix2.getRows() || matrix2.isEmpty()) {
+            std::cout << "Error: solve needs a right-hand side with as many rows as the matrix!\n";
+            return BasicMatrix<Real>();
+        }
+        BasicMatrix<Real> result = convert<Real>(matrix2);
+        if (isGeneralBand(matrix1)) {
+            std::vector<Real> band = bandStorage<Real>(matrix1);
+            std::vector<int> pivots(matrix1.n);
+            if (LuKernel::bandFactor(matrix1.n, matrix1.lower, matrix1.upper, band.data(), pivots.data()) == 0) {
+                std::cout << "Error: Matrix is singular!\n";
+                return BasicMatrix<Real>();
+            }
+            LuKernel::bandSolve(matrix1.n, matrix1.lower, matrix1.upper, band.data(), pivots.data(),
+                                result.getCols(), result.data(), result.stride());
+            return result;
+        }
+        if (matrix1.kind == MatrixStructure::Identity) {
+            return result;
+        }
+        for (int i = 0; i < matrix1.n; i++) {
+            if (matrix1.diagonalEntry(i) == T(0)) {
+                std::cout << "Error: Matrix is singular!\n";
+                return BasicMatrix<Real>();
+            }
+        }
+        const int cols = result.getCols();
+        const bool forward = matrix1.upper == 0;
+        for (int step = 0; step < matrix1.n; step++) {
+            const int i = forward ? step : matrix1.n - 1 - step;
+            Real* x = result.data() + static_cast<std::size_t>(i) * result.stride();
+            matrix1.forRow(i, [&](int k, T value) {
+                if (k == i) {
+                    return;
+                }
+                const Real v = static_cast<Real>(value);
+                const Real* xk = result.data() + static_cast<std::size_t>(k) * result.stride();
+                for (int j = 0; j < cols; j++) {
+                    x[j] -= v * xk[j];
+                }
+            });
+            const Real inverse = Real(1) / static_cast<Real>(matrix1.diagonalEntry(i));
+            for (int j = 0; j < cols; j++) {
+                x[j] *= inverse;
+            }
+        }
+        return result;
+    }
+
+    // Product of the diagonal for triangular shapes. A general band is
+    // eliminated on band storage: exactly (fraction-free) for integers, by
+    // the banded LU otherwise.
+    static Determinant determinant(const Structured& matrix1) {
+        if (isGeneralBand(matrix1)) {
+            return bandDeterminant(matrix1, std::is_integral<T>());
+        }
+        return diagonalDeterminant(matrix1, std::is_integral<T>());
+    }
+
+private:
+    // Neither upper nor lower triangular, so substitution cannot solve it
+    static bool isGeneralBand(const Structured& matrix1) {
+        return matrix1.kind != MatrixStructure::Identity && matrix1.lower > 0 && matrix1.upper > 0;
+    }
+
+    // matrix1 in LuKernel's band storage, fill-in columns zeroed
+    template <typename U>
+    static std::vector<U> bandStorage(const Structured& matrix1) {
+        const int width = LuKernel::bandWidth(matrix1.lower, matrix1.upper);
+        std::vector<U> band(static_cast<std::size_t>(matrix1.n) * width, U());
+        for (int i = 0; i < matrix1.n; i++) {
+            U* row = band.data() + static_cast<std::size_t>(i) * width - i + matrix1.lower;
+            matrix1.forRow(i, [row](int j, T value) { row[j] = static_cast<U>(value); });
+        }
+        return band;
+    }
+
+    // Integer products are checked the way the dense Bareiss path is
+    static Determinant diagonalDeterminant(const Structured& matrix1, std::true_type) {
+        Determinant result = Determinant(1);
+        for (int i = 0; i < matrix1.n; i++) {
+            if (__builtin_mul_overflow(result, static_cast<Determinant>(matrix1.diagonalEntry(i)), &result)) {
+                std::cout << "Error: Determinant does not fit in a 64-bit integer!\n";
+                return 0;
+            }
+        }
+        return result;
+    }
+
+    static Determinant diagonalDeterminant(const Structured& matrix1, std::false_type) {
+        Determinant result = Determinant(1);
+        for (int i = 0; i < matrix1.n; i++) {
+            result *= static_cast<Determinant>(matrix1.diagonalEntry(i));
+        }
+        return result;
+    }
+
+    static Determinant bandDeterminant(const Structured& matrix1, std::true_type) {
+        Determinant result = 0;
+        if (!LuKernel::bandBareissDeterminant(matrix1.n, matrix1.lower, matrix1.upper,
+                                              bandStorage<T>(matrix1).data(), result)) {
+            std::cout << "Error: Determinant does not fit in a 64-bit integer!\n";
+            return 0;
+        }
+        return result;
+    }
+
+    static Determinant bandDeterminant(const Structured& matrix1, std::false_type) {
+        std::vector<Real> band = bandStorage<Real>(matrix1);
+        std::vector<int> pivots(matrix1.n);
+        Real result = static_cast<Real>(
+            LuKernel::bandFactor(matrix1.n, matrix1.lower, matrix1.upper, band.data(), pivots.data()));
+        const int width = LuKernel::bandWidth(matrix1.lower, matrix1.upper);
+        for (int i = 0; i < matrix1.n && result != Real(0); i++) {
+            result *= band[static_cast<std::size_t>(i) * width + matrix1.lower];
+        }
+        return static_cast<Determinant>(result);
+    }
+
+    static Structured combine(const Structured& matrix1, const Structured& matrix2, T sign, const char* operation) {
+        if (matrix1.n != matrix2.n) {
+            std::cout << "Error: Matrices must have same dimensions for " << operation << "!\n";
+            return Structured();
+        }
+        Structured result = Structured::withBands(matrix1.n, std::max(matrix1.lower, matrix2.lower),
+                                                  std::max(matrix1.upper, matrix2.upper));
+        for (int i = 0; i < result.n; i++) {
+            T* c = result.rowData(i) - result.firstCol(i);
+            matrix1.forRow(i, [c](int j, T value) { c[j] = static_cast<T>(c[j] + value); });
+            matrix2.forRow(i, [c, sign](int j, T value) { c[j] = static_cast<T>(c[j] + sign * value); });
+        }
+        return result;
+    }
+
+    template <typename U>
+    static BasicMatrix<U> convert(const Matrix& matrix1) {
+        BasicMatrix<U> result(matrix1.getRows(), matrix1.getCols());
+        for (int i = 0; i < matrix1.getRows(); i++) {
+            const T* a = matrix1.data() + static_cast<std::size_t>(i) * matrix1.stride();
+            U* c = result.data() + static_cast<std::size_t>(i) * result.stride();
+            for (int j = 0; j < matrix1.getCols(); j++) {
+                c[j] = static_cast<U>(a[j]);
+            }
+        }
+        return result;
+    }
+
+    template <typename U>
+    static StructuredMatrix<U> convert(const Structured& matrix1) {
+        StructuredMatrix<U> result(matrix1.kind, matrix1.n, matrix1.lower, matrix1.upper);
+        std::copy(matrix1.values.begin(), matrix1.values.end(), result.values.begin());
+        return result;
+    }
+
+    static void reportShapes(int rows1, int cols1, int rows2, int cols2) {
+        std::cout << "Error: First matrix columns must equal second matrix rows for multiplication!\n";
+        std::cout << "Matrix 1: " << rows1 << "x" << cols1 << "\n";
+        std::cout << "Matrix 2: " << rows2 << "x" << cols2 << "\n";
+    }
+
+    // body(begin, end) over row ranges, in parallel when the work is large
+    template <typename Body>
+    static void forRowChunks(int rows, std::size_t work, const Body& body) {
+        ThreadPool& pool = ThreadPool::instance();
+        if (work < PARALLEL_WORK || pool.size() == 1 || rows < 2) {
+            body(0, rows);
+            return;
+        }
+        const int chunks = std::min(rows, 4 * pool.size());
+        pool.parallelFor(chunks, 0, [&](int t) {
+            body(static_cast<int>(static_cast<long long>(rows) * t / chunks),
+                 static_cast<int>(static_cast<long long>(rows) * (t + 1) / chunks));
+        });
+    }
+};
+
+#endif // MATRIX_STRUCTURED_H
@@ -0,0 +1,365 @@
+// Regression tests for the matrix library.
+//
+// Each check compares an optimized path against a naive reference or a
+// known answer: GEMM and Strassen products, LU solves and determinants,
+// sparse and structured products, matrix file round trips and the
+// out-of-core product, batches, task graphs and the result cache.
+// Failures are listed by name and make the exit status nonzero. Error
+// messages the library prints for the deliberately invalid cases are
+// expected output.
+//
+//     g++ -std=c++17 -O2 -pthread tests/tests.cpp -o tests/run_tests
+//     ./tests/run_tests
+//
+// Running with MATRIX_NUM_THREADS set to more than one exercises the
+// parallel paths.
+
+#include "../batch.h"
+#include "../graph.h"
+#include "../matrix_io.h"
+#include "../result_cache.h"
+#include "../sparse.h"
+#include "../structured.h"
+#include "../utility.h"
+#ifdef MATRIX_FILE_MMAP
+#include "../out_of_core.h"
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool passed, const string& name) {
+    if (!passed) {
+        cout << "FAIL: " << name << "\n";
+        failures++;
+    }
+}
+
+template <typename T>
+static BasicMatrix<T> randomMatrix(int rows, int cols, mt19937& random, int range = 9, double density = 1.0) {
+    uniform_int_distribution<int> value(-range, range);
+    uniform_real_distribution<double> keep(0.0, 1.0);
+    BasicMatrix<T> result(rows, cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            if (keep(random) < density) {
+                result.setElement(i, j, static_cast<T>(value(random)));
+            }
+        }
+    }
+    return result;
+}
+
+template <typename R, typename T>
+static BasicMatrix<R> naiveMultiply(const BasicMatrix<T>& matrix1, const BasicMatrix<T>& matrix2) {
+    BasicMatrix<R> result(matrix1.getRows(), matrix2.getCols());
+    for (int i = 0; i < matrix1.getRows(); i++) {
+        for (int j = 0; j < matrix2.getCols(); j++) {
+            R sum = R();
+            for (int k = 0; k < matrix1.getCols(); k++) {
+                sum += static_cast<R>(matrix1.getElement(i, k)) * static_cast<R>(matrix2.getElement(k, j));
+            }
+            result.setElement(i, j, sum);
+        }
+    }
+    return result;
+}
+
+template <typename T, typename U>
+static bool near(const BasicMatrix<T>& matrix1, const BasicMatrix<U>& matrix2, double tolerance = 1e-9) {
+    if (matrix1.getRows() != matrix2.getRows() || matrix1.getCols() != matrix2.getCols()) {
+        return false;
+    }
+    for (int i = 0; i < matrix1.getRows(); i++) {
+        for (int j = 0; j < matrix1.getCols(); j++) {
+            const double x = static_cast<double>(matrix1.getElement(i, j));
+            const double y = static_cast<double>(matrix2.getElement(i, j));
+            if (fabs(x - y) > tolerance * max(1.0, fabs(y))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void testGemm(mt19937& random) {
+    const int shapes[][3] = { {1, 1, 1}, {7, 13, 5}, {64, 64, 64}, {130, 257, 65}, {301, 95, 190} };
+    for (const auto& shape : shapes) {
+        const string name = "gemm " + to_string(shape[0]) + "x" + to_string(shape[1]) + "x" + to_string(shape[2]);
+        const Matrix a = randomMatrix<int>(shape[0], shape[1], random);
+        const Matrix b = randomMatrix<int>(shape[1], shape[2], random);
+        check(MatrixOperations::isEqual(MatrixOperations::multiply(a, b), naiveMultiply<int>(a, b)), name + " int");
+
+        const BasicMatrix<double> c = randomMatrix<double>(shape[0], shape[1], random);
+        const BasicMatrix<double> d = randomMatrix<double>(shape[1], shape[2], random);
+        check(near(BasicMatrixOperations<double>::multiply(c, d), naiveMultiply<double>(c, d)), name + " double");
+    }
+
+    // The parallel product must not depend on the thread count
+    const BasicMatrix<float> a = randomMatrix<float>(257, 1001, random);
+    const BasicMatrix<float> b = randomMatrix<float>(1001, 130, random);
+    const BasicMatrix<float> serial = BasicMatrixOperations<float>::multiply(a, b, 1, 0);
+    for (int threads : {2, 3, 4}) {
+        check(BasicMatrixOperations<float>::isEqual(BasicMatrixOperations<float>::multiply(a, b, threads, 0), serial),
+              "gemm float " + to_string(threads) + " threads");
+    }
+}
+
+static void testStrassen(mt19937& random) {
+    for (int n : {16, 64, 100, 127}) {
+        const Matrix a = randomMatrix<int>(n, n, random);
+        const Matrix b = randomMatrix<int>(n, n, random);
+        check(MatrixOperations::isEqual(MatrixOperations::multiplyStrassen(a, b, 16), naiveMultiply<int>(a, b)),
+              "strassen " + to_string(n));
+    }
+}
+
+static void testLu(mt19937& random) {
+    const int n = 50;
+    BasicMatrix<double> a = randomMatrix<double>(n, n, random);
+    for (int i = 0; i < n; i++) {
+        a.setElement(i, i, a.getElement(i, i) + 10.0 * n);
+    }
+    const BasicMatrix<double> b = randomMatrix<double>(n, 3, random);
+    const BasicMatrix<double> x = BasicMatrixOperations<double>::solve(a, b);
+    check(near(naiveMultiply<double>(a, x), b, 1e-9), "lu solve residual");
+
+    Matrix small(3, 3);
+    const int values[] = { 2, -3, 1, 2, 0, -1, 1, 4, 5 };
+    for (int p = 0; p < 9; p++) {
+        small.setElement(p / 3, p % 3, values[p]);
+    }
+    check(MatrixOperations::determinant(small) == 49, "bareiss 3x3");
+
+    // Exact integer determinants agree with the floating-point LU
+    for (int size = 1; size <= 8; size++) {
+        const Matrix c = randomMatrix<int>(size, size, random);
+        BasicMatrix<double> d(size, size);
+        for (int i = 0; i < size; i++) {
+            for (int j = 0; j < size; j++) {
+                d.setElement(i, j, c.getElement(i, j));
+            }
+        }
+        const double lu = BasicMatrixOperations<double>::determinant(d);
+        check(fabs(static_cast<double>(MatrixOperations::determinant(c)) - lu) <= 1e-6 * max(1.0, fabs(lu)),
+              "bareiss " + to_string(size) + "x" + to_string(size));
+    }
+
+    const Matrix large = randomMatrix<int>(6, 6, random, 2000000000);
+    long long determinant = 1;
+    check(!MatrixOperations::determinant(large, determinant) && determinant == 0, "bareiss overflow reported");
+}
+
+static void testSparse(mt19937& random) {
+    const Matrix dense = randomMatrix<int>(60, 45, random, 9, 0.1);
+    const Matrix other = randomMatrix<int>(45, 30, random);
+    const Matrix left = randomMatrix<int>(20, 60, random);
+    typedef SparseOperations<int> Sparse;
+    for (SparseFormat format : {SparseFormat::Csr, SparseFormat::Csc}) {
+        const SparseMatrix<int> sparse = SparseMatrix<int>::fromDense(dense, format);
+        const string name = format == SparseFormat::Csr ? "sparse csr" : "sparse csc";
+        check(MatrixOperations::isEqual(sparse.toDense(), dense), name + " round trip");
+        check(MatrixOperations::isEqual(Sparse::multiply(sparse, other), naiveMultiply<int>(dense, other)),
+              name + " * dense");
+        check(MatrixOperations::isEqual(Sparse::multiply(left, sparse), naiveMultiply<int>(left, dense)),
+              "dense * " + name);
+
+        const SparseMatrix<int> sparse2 = SparseMatrix<int>::fromDense(randomMatrix<int>(45, 30, random, 9, 0.1),
+                                                                       format);
+        check(MatrixOperations::isEqual(Sparse::multiply(sparse, sparse2).toDense(),
+                                        naiveMultiply<int>(dense, sparse2.toDense())),
+              name + " * sparse");
+
+        vector<int> vector1(45);
+        for (int j = 0; j < 45; j++) {
+            vector1[j] = j % 7 - 3;
+        }
+        const vector<int> product = Sparse::multiply(sparse, vector1);
+        bool same = product.size() == 60;
+        for (int i = 0; i < 60 && same; i++) {
+            int sum = 0;
+            for (int j = 0; j < 45; j++) {
+                sum += dense.getElement(i, j) * vector1[j];
+            }
+            same = product[i] == sum;
+        }
+        check(same, name + " * vector");
+    }
+}
+
+static void testStructured(mt19937& random) {
+    typedef StructuredOperations<int> Structured;
+    const int n = 40;
+    for (int lower = 0; lower <= 2; lower++) {
+        for (int upper = 0; upper <= 2; upper++) {
+            const string name = "structured " + to_string(lower) + "," + to_string(upper);
+            const StructuredMatrix<int> band = StructuredMatrix<int>::fromDense(randomMatrix<int>(n, n, random),
+                                                                               lower, upper);
+            const Matrix dense = band.toDense();
+            const Matrix other = randomMatrix<int>(n, 7, random);
+            check(MatrixOperations::isEqual(Structured::multiply(band, other), naiveMultiply<int>(dense, other)),
+                  name + " * dense");
+            const Matrix left = randomMatrix<int>(7, n, random);
+            check(MatrixOperations::isEqual(Structured::multiply(left, band), naiveMultiply<int>(left, dense)),
+                  "dense * " + name);
+            const StructuredMatrix<int> band2 = StructuredMatrix<int>::fromDense(randomMatrix<int>(n, n, random),
+                                                                                upper, lower);
+            check(MatrixOperations::isEqual(Structured::multiply(band, band2).toDense(),
+                                            naiveMultiply<int>(dense, band2.toDense())),
+                  name + " * structured");
+
+            // Solves and determinants against the dense LU
+            StructuredMatrix<int> dominant = band;
+            for (int i = 0; i < n; i++) {
+                dominant.setElement(i, i, 50);
+            }
+            const Matrix rhs = randomMatrix<int>(n, 2, random);
+            check(near(Structured::solve(dominant, rhs), MatrixOperations::solve(dominant.toDense(), rhs), 1e-9),
+                  name + " solve");
+            const StructuredMatrix<int> small = StructuredMatrix<int>::fromDense(randomMatrix<int>(8, 8, random, 3),
+                                                                                lower, upper);
+            check(Structured::determinant(small) == MatrixOperations::determinant(small.toDense()),
+                  name + " determinant");
+        }
+    }
+
+    check(Structured::determinant(StructuredMatrix<int>::diagonal(vector<int>(40, 100003))) == 0,
+          "structured diagonal determinant overflow reported");
+    check(Structured::determinant(StructuredMatrix<int>::diagonal({2, -3, 7})) == -42,
+          "structured diagonal determinant");
+}
+
+static void testFiles(mt19937& random) {
+    const string pathA = "matrix_tests_a.mat";
+    const string pathB = "matrix_tests_b.mat";
+    const string pathC = "matrix_tests_c.mat";
+
+    const Matrix a = randomMatrix<int>(37, 70, random);
+    check(MatrixFile::save(pathA, a) && MatrixOperations::isEqual(MatrixFile::load<int>(pathA, true), a),
+          "file round trip int");
+    const BasicMatrix<double> d = randomMatrix<double>(5, 3, random);
+    check(MatrixFile::save(pathB, d)
+              && BasicMatrixOperations<double>::isEqual(MatrixFile::load<double>(pathB, true), d),
+          "file round trip double");
+    check(MatrixFile::load<float>(pathB).isEmpty(), "file element type checked");
+
+#ifdef MATRIX_FILE_MMAP
+    const Matrix b = randomMatrix<int>(70, 150, random);
+    MatrixFile::save(pathB, b);
+    check(OutOfCoreOperations<int>::multiply(pathA, pathB, pathC, std::size_t(1) << 20)
+              && MatrixOperations::isEqual(MatrixFile::load<int>(pathC, true), naiveMultiply<int>(a, b)),
+          "out-of-core multiply");
+    check(!OutOfCoreOperations<int>::multiply(pathA, pathB, pathC, std::size_t(1) << 10), "out-of-core budget checked");
+
+    const Matrix square = MatrixOperations::scalarMultiply(MatrixOperations::createIdentityMatrix(70), 2);
+    MatrixFile::save(pathC, square);
+    check(!OutOfCoreOperations<int>::multiply(pathC, pathC, pathC)
+              && MatrixOperations::isEqual(MatrixFile::load<int>(pathC, true), square),
+          "out-of-core aliased result rejected");
+#endif
+
+    std::remove(pathA.c_str());
+    std::remove(pathB.c_str());
+    std::remove(pathC.c_str());
+}
+
+static void testBatch(mt19937& random) {
+    vector<Matrix> left;
+    vector<Matrix> right;
+    for (int b = 0; b < 600; b++) {
+        left.push_back(randomMatrix<int>(3, 4, random));
+        right.push_back(randomMatrix<int>(4, 2, random));
+    }
+    const MatrixBatch<int> product = BatchOperations<int>::multiply(MatrixBatch<int>::fromMatrices(left),
+                                                                    MatrixBatch<int>::fromMatrices(right));
+    bool same = product.size() == 600;
+    for (int b = 0; b < 600 && same; b++) {
+        same = MatrixOperations::isEqual(product.matrix(b), naiveMultiply<int>(left[b], right[b]));
+    }
+    check(same, "batch multiply");
+
+    const MatrixBatch<int> sum = BatchOperations<int>::add(MatrixBatch<int>::fromMatrices(left),
+                                                           MatrixBatch<int>::fromMatrices(left));
+    check(MatrixOperations::isEqual(sum.matrix(599), MatrixOperations::scalarMultiply(left[599], 2)), "batch add");
+}
+
+static void testGraph(mt19937& random) {
+    const Matrix a = randomMatrix<int>(30, 30, random);
+    const Matrix b = randomMatrix<int>(30, 30, random);
+    {
+        MatrixGraph<int> graph;
+        MatrixGraph<int>::Task x = graph.input(a);
+        MatrixGraph<int>::Task y = graph.input(b);
+        MatrixGraph<int>::Task result = graph.add(graph.multiply(x, y), graph.transpose(x));
+        shared_future<MatrixGraph<int>::Value> future = graph.future(result);
+        graph.run();
+        check(MatrixOperations::isEqual(*future.get(), MatrixOperations::add(naiveMultiply<int>(a, b),
+                                                                             MatrixOperations::transpose(a))),
+              "graph result");
+    }
+    {
+        MatrixGraph<int> graph;
+        MatrixGraph<int>::Task x = graph.input(a);
+        MatrixGraph<int>::Task failing = graph.apply({x}, [](const vector<const Matrix*>&) -> Matrix {
+            throw runtime_error("kernel failed");
+        });
+        shared_future<MatrixGraph<int>::Value> future = graph.future(graph.transpose(failing));
+        graph.run();
+        bool thrown = false;
+        try {
+            future.get();
+        } catch (const runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "graph exception propagated");
+    }
+}
+
+static void testCache(mt19937& random) {
+    MatrixResultCache<int> cache;
+    const Matrix a = randomMatrix<int>(20, 20, random);
+    const Matrix first = cache.multiply(a, a);
+    const Matrix second = cache.multiply(a, a);
+    check(MatrixOperations::isEqual(first, naiveMultiply<int>(a, a)) && MatrixOperations::isEqual(second, first)
+              && cache.hits() == 1,
+          "cache multiply hit");
+
+    // Failures are recomputed (and reported) every time, never stored
+    const Matrix large = randomMatrix<int>(6, 6, random, 2000000000);
+    cache.determinant(large);
+    cache.determinant(Matrix(2, 3));
+    check(cache.determinant(large) == 0 && cache.determinant(Matrix(2, 3)) == 0 && cache.size() == 1,
+          "cache skips failed determinants");
+    cache.determinant(MatrixOperations::createIdentityMatrix(4));
+    check(cache.determinant(MatrixOperations::createIdentityMatrix(4)) == 1 && cache.size() == 2 && cache.hits() == 2,
+          "cache determinant hit");
+}
+
+int main() {
+    mt19937 random(2024);
+    testGemm(random);
+    testStrassen(random);
+    testLu(random);
+    testSparse(random);
+    testStructured(random);
+    testFiles(random);
+    testBatch(random);
+    testGraph(random);
+    testCache(random);
+
+    if (failures > 0) {
+        cout << failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "All checks passed\n";
+    return 0;
+}
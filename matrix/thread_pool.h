@@ -0,0 +1,193 @@
+#ifndef MATRIX_THREAD_POOL_H
+#define MATRIX_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool - persistent workers shared by all parallel matrix kernels.
+//
+// Workers pick closures off one shared queue. Data-parallel loops go through
+// parallelFor(), which gives every participating thread its own deque of
+// task indices: a participant pops from the back of its own deque and, when
+// that runs dry, steals from the front of the others. The calling thread
+// always participates, so parallelFor() may be nested inside a task without
+// deadlocking even when every worker is busy.
+class ThreadPool {
+private:
+    struct Slot {
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+
+    // State of one parallelFor() call, shared with the helper closures that
+    // may outlive the call itself
+    struct Job {
+        std::function<void(int)> body;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::atomic<int> nextSlot;
+        std::atomic<int> remaining;
+        std::mutex doneLock;
+        std::condition_variable doneSignal;
+
+        Job(int participants, int count, const std::function<void(int)>& fn)
+            : body(fn), nextSlot(1), remaining(count) {
+            for (int s = 0; s < participants; s++) {
+                slots.push_back(std::unique_ptr<Slot>(new Slot()));
+            }
+            // Contiguous ranges per slot keep neighbouring tiles on one thread
+            for (int t = 0; t < count; t++) {
+                slots[static_cast<std::size_t>(t) * participants / count]->tasks.push_back(t);
+            }
+        }
+
+        bool take(int slot, int& task) {
+            Slot& own = *slots[slot];
+            {
+                std::lock_guard<std::mutex> guard(own.lock);
+                if (!own.tasks.empty()) {
+                    task = own.tasks.back();
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+            for (std::size_t k = 1; k < slots.size(); k++) {
+                Slot& victim = *slots[(slot + k) % slots.size()];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void participate(int slot) {
+            int task;
+            while (take(slot, task)) {
+                body(task);
+                if (remaining.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> guard(doneLock);
+                    doneSignal.notify_all();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex queueLock;
+    std::condition_variable queueSignal;
+    bool stopping;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(queueLock);
+                queueSignal.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    // threads counts the caller too, so threads - 1 workers are started
+    explicit ThreadPool(int threads) : stopping(false) {
+        for (int t = 1; t < threads; t++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            stopping = true;
+        }
+        queueSignal.notify_all();
+        for (std::thread& w : workers) {
+            w.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool, sized from MATRIX_NUM_THREADS when set and from the
+    // hardware concurrency otherwise
+    static ThreadPool& instance() {
+        static ThreadPool pool(defaultThreadCount());
+        return pool;
+    }
+
+    static int defaultThreadCount() {
+        const char* env = std::getenv("MATRIX_NUM_THREADS");
+        if (env != nullptr && std::atoi(env) > 0) {
+            return std::atoi(env);
+        }
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 0 ? static_cast<int>(hw) : 1;
+    }
+
+    // Total threads available to a parallelFor(), caller included
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Queue a closure for any worker (runs inline when the pool has none)
+    void submit(std::function<void()> task) {
+        if (workers.empty()) {
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(queueLock);
+            queue.push_back(std::move(task));
+        }
+        queueSignal.notify_one();
+    }
+
+    // Call body(t) for every t in [0, count) on up to maxThreads threads
+    // (0 means the whole pool) and return once all calls have finished
+    void parallelFor(int count, int maxThreads, const std::function<void(int)>& body) {
+        if (count <= 0) {
+            return;
+        }
+        int participants = maxThreads > 0 ? std::min(maxThreads, size()) : size();
+        participants = std::min(participants, count);
+        if (participants <= 1) {
+            for (int t = 0; t < count; t++) {
+                body(t);
+            }
+            return;
+        }
+
+        std::shared_ptr<Job> job = std::make_shared<Job>(participants, count, body);
+        for (int p = 1; p < participants; p++) {
+            submit([job] {
+                int slot = job->nextSlot.fetch_add(1);
+                if (slot < static_cast<int>(job->slots.size())) {
+                    job->participate(slot);
+                }
+            });
+        }
+
+        job->participate(0);
+
+        std::unique_lock<std::mutex> guard(job->doneLock);
+        job->doneSignal.wait(guard, [&job] { return job->remaining.load() == 0; });
+    }
+};
+
+#endif // MATRIX_THREAD_POOL_H
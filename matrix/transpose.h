@@ -0,0 +1,109 @@
+#ifndef MATRIX_TRANSPOSE_H
+#define MATRIX_TRANSPOSE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// TransposeKernel - cache-oblivious transposition.
+//
+// The out-of-place and square in-place variants recursively halve the
+// longer side until a block fits comfortably in L1, so reads and writes
+// both stay within a few cache lines at every level of the hierarchy
+// without tuning for a particular cache size. Rectangular in-place
+// transposition of a dense buffer follows the permutation cycles.
+class TransposeKernel {
+public:
+    // Blocks with both sides at or below this are transposed directly
+    static constexpr int BASE_BLOCK = 16;
+
+    // dst (cols x rows, row stride ldd) = transpose of src (rows x cols)
+    template <typename T>
+    static void transpose(int rows, int cols, const T* src, std::ptrdiff_t lds,
+                          T* dst, std::ptrdiff_t ldd) {
+        if (rows <= BASE_BLOCK && cols <= BASE_BLOCK) {
+            for (int i = 0; i < rows; i++) {
+                const T* s = src + i * lds;
+                for (int j = 0; j < cols; j++) {
+                    dst[j * ldd + i] = s[j];
+                }
+            }
+        } else if (rows >= cols) {
+            const int half = rows / 2;
+            transpose(half, cols, src, lds, dst, ldd);
+            transpose(rows - half, cols, src + half * lds, lds, dst + half, ldd);
+        } else {
+            const int half = cols / 2;
+            transpose(rows, half, src, lds, dst, ldd);
+            transpose(rows, cols - half, src + half, lds, dst + half * ldd, ldd);
+        }
+    }
+
+    // Transpose an n x n block in place
+    template <typename T>
+    static void transposeSquare(int n, T* a, std::ptrdiff_t lda) {
+        if (n <= BASE_BLOCK) {
+            for (int i = 0; i < n; i++) {
+                for (int j = i + 1; j < n; j++) {
+                    std::swap(a[i * lda + j], a[j * lda + i]);
+                }
+            }
+            return;
+        }
+        const int half = n / 2;
+        transposeSquare(half, a, lda);
+        transposeSquare(n - half, a + half * lda + half, lda);
+        swapTransposed(half, n - half, a + half, a + half * lda, lda);
+    }
+
+    // Transpose a dense rows x cols buffer (row stride == cols) in place,
+    // leaving a dense cols x rows buffer. Element p = i * cols + j belongs at
+    // j * rows + i, i.e. p * rows mod (rows * cols - 1); each cycle of that
+    // permutation is rotated once, with one bit per element marking the
+    // positions already placed.
+    template <typename T>
+    static void transposeDense(int rows, int cols, T* a) {
+        const std::size_t count = static_cast<std::size_t>(rows) * cols;
+        if (rows <= 1 || cols <= 1) {
+            return;
+        }
+        const std::size_t modulus = count - 1;
+        std::vector<bool> placed(count, false);
+        for (std::size_t start = 1; start < modulus; start++) {
+            if (placed[start]) {
+                continue;
+            }
+            std::size_t p = start;
+            T carried = a[p];
+            do {
+                const std::size_t next = p * static_cast<std::size_t>(rows) % modulus;
+                std::swap(carried, a[next]);
+                placed[next] = true;
+                p = next;
+            } while (p != start);
+        }
+    }
+
+private:
+    // Exchange X (r x c at x) with the transpose of Y (c x r at y)
+    template <typename T>
+    static void swapTransposed(int r, int c, T* x, T* y, std::ptrdiff_t ld) {
+        if (r <= BASE_BLOCK && c <= BASE_BLOCK) {
+            for (int i = 0; i < r; i++) {
+                for (int j = 0; j < c; j++) {
+                    std::swap(x[i * ld + j], y[j * ld + i]);
+                }
+            }
+        } else if (r >= c) {
+            const int half = r / 2;
+            swapTransposed(half, c, x, y, ld);
+            swapTransposed(r - half, c, x + half * ld, y + half, ld);
+        } else {
+            const int half = c / 2;
+            swapTransposed(r, half, x, y, ld);
+            swapTransposed(r, c - half, x + half, y + half * ld, ld);
+        }
+    }
+};
+
+#endif // MATRIX_TRANSPOSE_H
@@ -3,83 +3,228 @@
 
 #include <iostream>
 #include <iomanip>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "allocator.h"
+#include "chain.h"
+#include "content_hash.h"
+#include "element_traits.h"
+#include "expression.h"
+#include "gemm.h"
+#include "instrumentation.h"
+#include "lu.h"
+#include "matrix_writer.h"
+#include "simd.h"
+#include "static_matrix.h"
+#include "strassen.h"
+#include "transpose.h"
+#include "view.h"
+
+template <typename T, typename Acc>
+class BasicMatrixOperations;
+
+class MatrixFile;
 
 // Matrix class - responsible for matrix data structure and basic operations
-class Matrix {
+//
+// Elements live in a single 64-byte aligned, row-major buffer. Each row is
+// padded to a multiple of 64 bytes so every row starts on a cache line;
+// element (i, j) is at data()[i * stride() + j]. A matrix loaded from a
+// file may instead point into a memory mapping, which it keeps alive
+// through storageOwner rather than freeing. Owned buffers come from a
+// MatrixAllocator, by default MatrixAllocator::current() at construction.
+//
+// contentHash() fingerprints the elements on first use and is remembered
+// until the matrix may have changed: setElement(), inputMatrix(), any
+// assignment and every non-const data() or view accessor forget it.
+// Writes through a pointer or view obtained before the hash was computed
+// are not seen; call invalidateHash() after writing that way.
+//
+// The element type is a template parameter; Matrix is the int instance
+// everything started out with.
+template <typename T>
+class BasicMatrix : public MatrixExpression<BasicMatrix<T>> {
+    static_assert(std::is_arithmetic<T>::value, "matrix elements must be arithmetic");
+
+public:
+    typedef T value_type;
+
+    static constexpr std::size_t ALIGNMENT = 64;
+    static_assert(ALIGNMENT <= MatrixAllocator::ALIGNMENT, "allocator alignment too small for matrix rows");
+
 private:
-    int** matrix;
+    T* matrix;
     int rows;
     int cols;
+    int rowStride;
+    std::shared_ptr<void> storageOwner;
+    MatrixAllocator* allocator; // source of an owned buffer
+    std::size_t capacity;       // elements allocated, kept for deallocate()
+    mutable std::atomic<std::uint64_t> hashValue; // 0 until contentHash() runs
+
+    // Round a column count up to a whole number of cache lines
+    static int paddedStride(int c) {
+        const int perLine = static_cast<int>(ALIGNMENT / sizeof(T));
+        return (c + perLine - 1) / perLine * perLine;
+    }
+
+    // Allocate bufferSize() elements from source (current() when null)
+    void acquire(MatrixAllocator* source) {
+        allocator = source != nullptr ? source : MatrixAllocator::current();
+        capacity = bufferSize();
+        matrix = static_cast<T*>(allocator->allocate(capacity * sizeof(T)));
+        MATRIX_INSTRUMENT_ALLOCATION(capacity * sizeof(T));
+    }
+
+    std::size_t bufferSize() const {
+        return static_cast<std::size_t>(rows) * rowStride;
+    }
+
+    // Drop the current buffer, whichever way it is owned
+    void releaseStorage() {
+        if (storageOwner) {
+            storageOwner.reset();
+        } else if (matrix != nullptr) {
+            allocator->deallocate(matrix, capacity * sizeof(T));
+        }
+        matrix = nullptr;
+        allocator = nullptr;
+        capacity = 0;
+    }
+
+    // Adopt storage owned elsewhere (see MatrixFile)
+    BasicMatrix(T* data, int r, int c, int stride, std::shared_ptr<void> owner)
+        : matrix(data), rows(r), cols(c), rowStride(stride), storageOwner(std::move(owner)),
+          allocator(nullptr), capacity(0), hashValue(0) {}
 
 public:
-    // Constructor
-    Matrix(int r = 0, int c = 0) : rows(r), cols(c) {
+    // Constructor; the buffer comes from source, or the current allocator
+    BasicMatrix(int r = 0, int c = 0, MatrixAllocator* source = nullptr)
+        : matrix(nullptr), rows(r), cols(c), rowStride(0), allocator(nullptr), capacity(0), hashValue(0) {
         if (rows > 0 && cols > 0) {
-            matrix = new int*[rows];
-            for (int i = 0; i < rows; i++) {
-                matrix[i] = new int[cols];
-                // Initialize to zero
-                for (int j = 0; j < cols; j++) {
-                    matrix[i][j] = 0;
-                }
-            }
+            rowStride = paddedStride(cols);
+            acquire(source);
+            // Initialize to zero (padding included)
+            std::memset(matrix, 0, bufferSize() * sizeof(T));
         } else {
-            matrix = nullptr;
+            rows = 0;
+            cols = 0;
         }
     }
 
     // Copy constructor
-    Matrix(const Matrix& other) : rows(other.rows), cols(other.cols) {
-        if (rows > 0 && cols > 0) {
-            matrix = new int*[rows];
-            for (int i = 0; i < rows; i++) {
-                matrix[i] = new int[cols];
-                for (int j = 0; j < cols; j++) {
-                    matrix[i][j] = other.matrix[i][j];
-                }
-            }
-        } else {
-            matrix = nullptr;
+    BasicMatrix(const BasicMatrix& other)
+        : matrix(nullptr), rows(other.rows), cols(other.cols), rowStride(other.rowStride),
+          allocator(nullptr), capacity(0), hashValue(other.knownHash()) {
+        if (other.matrix != nullptr) {
+            acquire(nullptr);
+            std::memcpy(matrix, other.matrix, bufferSize() * sizeof(T));
         }
     }
 
-    // Destructor
-    ~Matrix() {
+    // Move constructor - steals the buffer and leaves other empty
+    BasicMatrix(BasicMatrix&& other) noexcept
+        : matrix(other.matrix), rows(other.rows), cols(other.cols), rowStride(other.rowStride),
+          storageOwner(std::move(other.storageOwner)), allocator(other.allocator), capacity(other.capacity),
+          hashValue(other.knownHash()) {
+        other.hashValue.store(0, std::memory_order_relaxed);
+        other.allocator = nullptr;
+        other.capacity = 0;
+        other.matrix = nullptr;
+        other.rows = 0;
+        other.cols = 0;
+        other.rowStride = 0;
+    }
+
+    // Evaluate an elementwise expression in one pass
+    template <typename E>
+    BasicMatrix(const MatrixExpression<E>& expr) : BasicMatrix(expr.getRows(), expr.getCols()) {
+        assignExpression(expr.self());
+    }
+
+    // Copy of a fixed-size matrix
+    template <int R, int C>
+    BasicMatrix(const StaticMatrix<R, C, T>& other) : BasicMatrix(R, C) {
+        for (int i = 0; i < R; i++) {
+            std::memcpy(rowPtr(i), other.data() + i * C, static_cast<std::size_t>(C) * sizeof(T));
+        }
+    }
+
+    // Copy of the elements a view looks at
+    explicit BasicMatrix(const ConstMatrixView<T>& source) : BasicMatrix(source.getRows(), source.getCols()) {
         if (matrix != nullptr) {
-            for (int i = 0; i < rows; i++) {
-                delete[] matrix[i];
-            }
-            delete[] matrix;
+            view().assign(source);
         }
     }
 
+    // Destructor
+    ~BasicMatrix() {
+        releaseStorage();
+    }
+
     // Assignment operator
-    Matrix& operator=(const Matrix& other) {
+    BasicMatrix& operator=(const BasicMatrix& other) {
         if (this != &other) {
-            // Clean up existing memory
-            if (matrix != nullptr) {
-                for (int i = 0; i < rows; i++) {
-                    delete[] matrix[i];
+            // Reuse the existing buffer when the shape is unchanged, and
+            // its allocator when it is not
+            if (matrix == nullptr || rows != other.rows || cols != other.cols
+                || rowStride != other.rowStride) {
+                MatrixAllocator* source = storageOwner ? nullptr : allocator;
+                releaseStorage();
+                rows = other.rows;
+                cols = other.cols;
+                rowStride = other.rowStride;
+                if (other.matrix != nullptr) {
+                    acquire(source);
                 }
-                delete[] matrix;
             }
+            if (matrix != nullptr) {
+                std::memcpy(matrix, other.matrix, bufferSize() * sizeof(T));
+            }
+            hashValue.store(other.knownHash(), std::memory_order_relaxed);
+        }
+        return *this;
+    }
 
-            // Copy new data
+    // Move assignment operator
+    BasicMatrix& operator=(BasicMatrix&& other) noexcept {
+        if (this != &other) {
+            releaseStorage();
+            matrix = other.matrix;
             rows = other.rows;
             cols = other.cols;
-            
-            if (rows > 0 && cols > 0) {
-                matrix = new int*[rows];
-                for (int i = 0; i < rows; i++) {
-                    matrix[i] = new int[cols];
-                    for (int j = 0; j < cols; j++) {
-                        matrix[i][j] = other.matrix[i][j];
-                    }
-                }
-            } else {
-                matrix = nullptr;
-            }
+            rowStride = other.rowStride;
+            storageOwner = std::move(other.storageOwner);
+            allocator = other.allocator;
+            capacity = other.capacity;
+            hashValue.store(other.knownHash(), std::memory_order_relaxed);
+            other.hashValue.store(0, std::memory_order_relaxed);
+            other.allocator = nullptr;
+            other.capacity = 0;
+            other.matrix = nullptr;
+            other.rows = 0;
+            other.cols = 0;
+            other.rowStride = 0;
+        }
+        return *this;
+    }
+
+    // Expression assignment - writes into the existing buffer when the shape
+    // matches, so A = A + B allocates nothing
+    template <typename E>
+    BasicMatrix& operator=(const MatrixExpression<E>& expr) {
+        if (rows != expr.getRows() || cols != expr.getCols()) {
+            *this = BasicMatrix(expr.getRows(), expr.getCols());
         }
+        assignExpression(expr.self());
         return *this;
     }
 
@@ -87,28 +232,84 @@ public:
     int getRows() const { return rows; }
     int getCols() const { return cols; }
 
+    // Raw row-major storage; rows are stride() elements apart
+    T* data() {
+        invalidateHash();
+        return matrix;
+    }
+    const T* data() const { return matrix; }
+    int stride() const { return rowStride; }
+
+    // Views of the whole matrix, a block, a row, a column or the transpose;
+    // none of them copy. The mutable ones forget the content hash.
+    ConstMatrixView<T> view() const { return ConstMatrixView<T>(matrix, rows, cols, rowStride); }
+    MatrixView<T> view() {
+        invalidateHash();
+        return MatrixView<T>(matrix, rows, cols, rowStride);
+    }
+
+    ConstMatrixView<T> block(int row, int col, int r, int c) const { return view().block(row, col, r, c); }
+    MatrixView<T> block(int row, int col, int r, int c) { return view().block(row, col, r, c); }
+
+    ConstMatrixView<T> row(int i) const { return view().row(i); }
+    MatrixView<T> row(int i) { return view().row(i); }
+
+    ConstMatrixView<T> col(int j) const { return view().col(j); }
+    MatrixView<T> col(int j) { return view().col(j); }
+
+    ConstMatrixView<T> transposed() const { return view().transposed(); }
+    MatrixView<T> transposed() { return view().transposed(); }
+
+    operator ConstMatrixView<T>() const { return view(); }
+    operator MatrixView<T>() { return view(); }
+
+    // Fingerprint of the shape and elements (see ContentHash), computed on
+    // first use and kept until the matrix is modified; never 0
+    std::uint64_t contentHash() const {
+        std::uint64_t hash = knownHash();
+        if (hash == 0) {
+            hash = ContentHash::matrix(matrix, rows, cols, rowStride);
+            hashValue.store(hash, std::memory_order_relaxed);
+        }
+        return hash;
+    }
+
+    // Forget the content hash after writing through an old pointer or view
+    void invalidateHash() { hashValue.store(0, std::memory_order_relaxed); }
+
+    // Allocator owning the buffer; null for empty or file-backed matrices
+    MatrixAllocator* getAllocator() const { return allocator; }
+
+    // Unchecked element read, used when evaluating expressions
+    T operator()(int i, int j) const { return rowPtr(i)[j]; }
+
     // Set element at specific position
-    void setElement(int row, int col, int value) {
+    void setElement(int row, int col, T value) {
         if (row >= 0 && row < rows && col >= 0 && col < cols) {
-            matrix[row][col] = value;
+            invalidateHash();
+            matrix[static_cast<std::size_t>(row) * rowStride + col] = value;
         }
     }
 
     // Get element at specific position
-    int getElement(int row, int col) const {
+    T getElement(int row, int col) const {
         if (row >= 0 && row < rows && col >= 0 && col < cols) {
-            return matrix[row][col];
+            return matrix[static_cast<std::size_t>(row) * rowStride + col];
         }
-        return 0; // Return 0 for invalid indices
+        return T(); // Return 0 for invalid indices
     }
 
     // Input matrix values
     void inputMatrix() {
+        invalidateHash();
         std::cout << "Enter matrix elements (" << rows << "x" << cols << "):\n";
         for (int i = 0; i < rows; i++) {
+            T* row = rowPtr(i);
             for (int j = 0; j < cols; j++) {
                 std::cout << "Element [" << i << "][" << j << "]: ";
-                std::cin >> matrix[i][j];
+                typename StreamTraits<T>::type value = 0;
+                std::cin >> value;
+                row[j] = static_cast<T>(value);
             }
         }
     }
@@ -121,11 +322,9 @@ public:
         }
         
         std::cout << "Matrix (" << rows << "x" << cols << "):\n";
-        for (int i = 0; i < rows; i++) {
-            for (int j = 0; j < cols; j++) {
-                std::cout << std::setw(6) << matrix[i][j] << " ";
-            }
-            std::cout << "\n";
+        {
+            MatrixWriter writer(std::cout);
+            writer.write(view());
         }
         std::cout << "\n";
     }
@@ -135,15 +334,53 @@ public:
         return matrix == nullptr || rows == 0 || cols == 0;
     }
 
+private:
+    // Every element depends only on the same position of its operands, so
+    // evaluating in place is safe even when the destination is an operand
+    template <typename E>
+    void assignExpression(const E& expr) {
+        invalidateHash();
+        for (int i = 0; i < rows; i++) {
+            T* c = rowPtr(i);
+            for (int j = 0; j < cols; j++) {
+                c[j] = static_cast<T>(expr(i, j));
+            }
+        }
+    }
+
+    // Content hash if already computed, else 0
+    std::uint64_t knownHash() const { return hashValue.load(std::memory_order_relaxed); }
+
+    T* rowPtr(int i) { return matrix + static_cast<std::size_t>(i) * rowStride; }
+    const T* rowPtr(int i) const { return matrix + static_cast<std::size_t>(i) * rowStride; }
+
+public:
     // Friend class declaration to allow MatrixOperations to access private members
-    friend class MatrixOperations;
+    template <typename U, typename A>
+    friend class BasicMatrixOperations;
+
+    friend class MatrixFile;
 };
 
+typedef BasicMatrix<int> Matrix;
+
 // MatrixOperations class - responsible for mathematical operations on matrices
-class MatrixOperations {
+//
+// Operates on BasicMatrix<T>. Products are accumulated in, and returned
+// as, BasicMatrix<Acc>; by default narrow integers widen to 32 bits (see
+// AccumulatorTraits) and other types keep their own.
+template <typename T, typename Acc = typename AccumulatorTraits<T>::type>
+class BasicMatrixOperations {
 public:
+    typedef BasicMatrix<T> Matrix;
+    typedef BasicMatrix<Acc> ProductMatrix;
+    typedef typename RealTraits<T>::type Real;
+    typedef BasicMatrix<Real> RealMatrix;
+    typedef typename DeterminantTraits<T>::type Determinant;
+
     // Static method for matrix addition
     static Matrix add(const Matrix& matrix1, const Matrix& matrix2) {
+        MATRIX_INSTRUMENT("add");
         // Check if matrices can be added
         if (matrix1.rows != matrix2.rows || matrix1.cols != matrix2.cols) {
             std::cout << "Error: Matrices must have same dimensions for addition!\n";
@@ -153,38 +390,114 @@ public:
         }
 
         Matrix result(matrix1.rows, matrix1.cols);
-        for (int i = 0; i < matrix1.rows; i++) {
-            for (int j = 0; j < matrix1.cols; j++) {
-                result.matrix[i][j] = matrix1.matrix[i][j] + matrix2.matrix[i][j];
-            }
-        }
+        MATRIX_INSTRUMENT_ELEMENTWISE(matrix1.rows, matrix1.cols, 3, sizeof(T));
+        applyBinary(SimdDispatch::kernels<T>().add, matrix1, matrix2, result);
         return result;
     }
 
     // Static method for matrix multiplication
-    static Matrix multiply(const Matrix& matrix1, const Matrix& matrix2) {
+    static ProductMatrix multiply(const Matrix& matrix1, const Matrix& matrix2) {
+        return multiply(matrix1, matrix2, 0, 0);
+    }
+
+    // Matrix multiplication on the shared thread pool. threads caps the
+    // number of threads (0 = all) and grain is the edge of the output tiles
+    // handed out to threads (0 = automatic). Small products run inline.
+    static ProductMatrix multiply(const Matrix& matrix1, const Matrix& matrix2, int threads, int grain) {
+        MATRIX_INSTRUMENT("multiply");
         // Check if matrices can be multiplied
         if (matrix1.cols != matrix2.rows) {
             std::cout << "Error: First matrix columns must equal second matrix rows for multiplication!\n";
             std::cout << "Matrix 1: " << matrix1.rows << "x" << matrix1.cols << "\n";
             std::cout << "Matrix 2: " << matrix2.rows << "x" << matrix2.cols << "\n";
-            return Matrix(); // Return empty matrix
+            return ProductMatrix(); // Return empty matrix
         }
 
-        Matrix result(matrix1.rows, matrix2.cols);
-        for (int i = 0; i < matrix1.rows; i++) {
-            for (int j = 0; j < matrix2.cols; j++) {
-                result.matrix[i][j] = 0;
-                for (int k = 0; k < matrix1.cols; k++) {
-                    result.matrix[i][j] += matrix1.matrix[i][k] * matrix2.matrix[k][j];
-                }
-            }
+        ProductMatrix result(matrix1.rows, matrix2.cols);
+        MATRIX_INSTRUMENT_GEMM(matrix1.rows, matrix2.cols, matrix1.cols, sizeof(T), sizeof(Acc),
+                               (GemmKernel<T, Acc>::plannedThreads(matrix1.rows, matrix2.cols, matrix1.cols, threads)));
+        GemmKernel<T, Acc>::multiplyParallel(matrix1.rows, matrix2.cols, matrix1.cols,
+                                     matrix1.matrix, matrix1.rowStride, 1,
+                                     matrix2.matrix, matrix2.rowStride, 1,
+                                     result.matrix, result.rowStride, threads, grain);
+        return result;
+    }
+
+    // Mixed products with a fixed-size matrix read its inline storage
+    // directly instead of converting it first
+    template <int R, int C>
+    static ProductMatrix multiply(const StaticMatrix<R, C, T>& matrix1, const Matrix& matrix2) {
+        MATRIX_INSTRUMENT("multiply");
+        if (C != matrix2.rows) {
+            std::cout << "Error: First matrix columns must equal second matrix rows for multiplication!\n";
+            std::cout << "Matrix 1: " << R << "x" << C << "\n";
+            std::cout << "Matrix 2: " << matrix2.rows << "x" << matrix2.cols << "\n";
+            return ProductMatrix();
+        }
+
+        ProductMatrix result(R, matrix2.cols);
+        MATRIX_INSTRUMENT_GEMM(R, matrix2.cols, C, sizeof(T), sizeof(Acc),
+                               (GemmKernel<T, Acc>::plannedThreads(R, matrix2.cols, C, 1)));
+        GemmKernel<T, Acc>::multiply(R, matrix2.cols, C, matrix1.data(), C, 1,
+                                     matrix2.matrix, matrix2.rowStride, 1,
+                                     result.matrix, result.rowStride);
+        return result;
+    }
+
+    template <int R, int C>
+    static ProductMatrix multiply(const Matrix& matrix1, const StaticMatrix<R, C, T>& matrix2) {
+        MATRIX_INSTRUMENT("multiply");
+        if (matrix1.cols != R) {
+            std::cout << "Error: First matrix columns must equal second matrix rows for multiplication!\n";
+            std::cout << "Matrix 1: " << matrix1.rows << "x" << matrix1.cols << "\n";
+            std::cout << "Matrix 2: " << R << "x" << C << "\n";
+            return ProductMatrix();
         }
+
+        ProductMatrix result(matrix1.rows, C);
+        MATRIX_INSTRUMENT_GEMM(matrix1.rows, C, R, sizeof(T), sizeof(Acc),
+                               (GemmKernel<T, Acc>::plannedThreads(matrix1.rows, C, R, 0)));
+        GemmKernel<T, Acc>::multiplyParallel(matrix1.rows, C, R, matrix1.matrix, matrix1.rowStride, 1,
+                                             matrix2.data(), C, 1,
+                                             result.matrix, result.rowStride, 0, 0);
         return result;
     }
 
+    // Copy a matrix into a fixed-size one; a shape mismatch is reported and
+    // yields a zero matrix
+    template <int R, int C>
+    static StaticMatrix<R, C, T> toStatic(const Matrix& matrix1) {
+        MATRIX_INSTRUMENT("toStatic");
+        StaticMatrix<R, C, T> result;
+        if (matrix1.rows != R || matrix1.cols != C) {
+            std::cout << "Error: Cannot convert " << matrix1.rows << "x" << matrix1.cols
+                      << " matrix to fixed size " << R << "x" << C << "!\n";
+            return result;
+        }
+        for (int i = 0; i < R; i++) {
+            std::memcpy(result.data() + i * C, matrix1.rowPtr(i), static_cast<std::size_t>(C) * sizeof(T));
+        }
+        return result;
+    }
+
+    // Strassen-Winograd multiplication for square matrices of equal size,
+    // recursing down to crossover (0 = default) before switching to the
+    // blocked kernel. Other shapes, and element types that widen on
+    // multiplication, fall back to multiply().
+    static ProductMatrix multiplyStrassen(const Matrix& matrix1, const Matrix& matrix2, int crossover = 0) {
+        StrassenWorkspace workspace;
+        return multiplyStrassen(matrix1, matrix2, crossover, workspace);
+    }
+
+    // As above, taking scratch memory from a caller-owned workspace
+    static ProductMatrix multiplyStrassen(const Matrix& matrix1, const Matrix& matrix2, int crossover,
+                                          StrassenWorkspace& workspace) {
+        MATRIX_INSTRUMENT("multiplyStrassen");
+        return strassen(matrix1, matrix2, crossover, workspace, std::is_same<T, Acc>());
+    }
     // Static method for matrix subtraction
     static Matrix subtract(const Matrix& matrix1, const Matrix& matrix2) {
+        MATRIX_INSTRUMENT("subtract");
         // Check if matrices can be subtracted
         if (matrix1.rows != matrix2.rows || matrix1.cols != matrix2.cols) {
             std::cout << "Error: Matrices must have same dimensions for subtraction!\n";
@@ -194,25 +507,27 @@ public:
         }
 
         Matrix result(matrix1.rows, matrix1.cols);
-        for (int i = 0; i < matrix1.rows; i++) {
-            for (int j = 0; j < matrix1.cols; j++) {
-                result.matrix[i][j] = matrix1.matrix[i][j] - matrix2.matrix[i][j];
-            }
-        }
+        MATRIX_INSTRUMENT_ELEMENTWISE(matrix1.rows, matrix1.cols, 3, sizeof(T));
+        applyBinary(SimdDispatch::kernels<T>().subtract, matrix1, matrix2, result);
         return result;
     }
 
     // Static method for scalar multiplication
-    static Matrix scalarMultiply(const Matrix& matrix1, int scalar) {
+    static Matrix scalarMultiply(const Matrix& matrix1, T scalar) {
+        MATRIX_INSTRUMENT("scalarMultiply");
         if (matrix1.isEmpty()) {
             std::cout << "Error: Cannot perform scalar multiplication on empty matrix!\n";
             return Matrix();
         }
 
         Matrix result(matrix1.rows, matrix1.cols);
-        for (int i = 0; i < matrix1.rows; i++) {
-            for (int j = 0; j < matrix1.cols; j++) {
-                result.matrix[i][j] = matrix1.matrix[i][j] * scalar;
+        MATRIX_INSTRUMENT_ELEMENTWISE(matrix1.rows, matrix1.cols, 2, sizeof(T));
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        if (matrix1.rowStride == result.rowStride) {
+            kernels.scale(matrix1.matrix, scalar, result.matrix, result.bufferSize());
+        } else {
+            for (int i = 0; i < matrix1.rows; i++) {
+                kernels.scale(matrix1.rowPtr(i), scalar, result.rowPtr(i), matrix1.cols);
             }
         }
         return result;
@@ -220,31 +535,67 @@ public:
 
     // Static method for matrix transpose
     static Matrix transpose(const Matrix& matrix1) {
+        MATRIX_INSTRUMENT("transpose");
         if (matrix1.isEmpty()) {
             std::cout << "Error: Cannot transpose empty matrix!\n";
             return Matrix();
         }
 
         Matrix result(matrix1.cols, matrix1.rows);
-        for (int i = 0; i < matrix1.rows; i++) {
-            for (int j = 0; j < matrix1.cols; j++) {
-                result.matrix[j][i] = matrix1.matrix[i][j];
-            }
-        }
+        MATRIX_INSTRUMENT_WORK(static_cast<unsigned long long>(matrix1.rows) * matrix1.cols,
+                               2ULL * matrix1.rows * matrix1.cols * sizeof(T));
+        MATRIX_INSTRUMENT_KERNEL("transpose", nullptr, 1);
+        TransposeKernel::transpose(matrix1.rows, matrix1.cols, matrix1.matrix, matrix1.rowStride,
+                                   result.matrix, result.rowStride);
         return result;
     }
 
+    // Transpose without allocating a new matrix. Square matrices are
+    // transposed within their existing layout; rectangular ones are first
+    // packed densely (row stride == cols) and then permuted by cycle
+    // following, so they come back with an unpadded stride.
+    static void transposeInPlace(Matrix& matrix1) {
+        MATRIX_INSTRUMENT("transposeInPlace");
+        if (matrix1.isEmpty()) {
+            std::cout << "Error: Cannot transpose empty matrix!\n";
+            return;
+        }
+        matrix1.invalidateHash();
+
+        if (matrix1.rows == matrix1.cols) {
+            TransposeKernel::transposeSquare(matrix1.rows, matrix1.matrix, matrix1.rowStride);
+            return;
+        }
+
+        // Rows only ever move towards the front, so ascending order is safe
+        for (int i = 1; i < matrix1.rows; i++) {
+            std::memmove(matrix1.matrix + static_cast<std::size_t>(i) * matrix1.cols, matrix1.rowPtr(i),
+                         static_cast<std::size_t>(matrix1.cols) * sizeof(T));
+        }
+        TransposeKernel::transposeDense(matrix1.rows, matrix1.cols, matrix1.matrix);
+        std::swap(matrix1.rows, matrix1.cols);
+        matrix1.rowStride = matrix1.cols;
+    }
+
     // Static method to check if two matrices are equal
     static bool isEqual(const Matrix& matrix1, const Matrix& matrix2) {
+        MATRIX_INSTRUMENT("isEqual");
         if (matrix1.rows != matrix2.rows || matrix1.cols != matrix2.cols) {
             return false;
         }
+        // Hashes are only compared once both are known; computing one costs
+        // as much as the scan it would save
+        const std::uint64_t hash1 = matrix1.knownHash();
+        const std::uint64_t hash2 = matrix2.knownHash();
+        if (hash1 != 0 && hash2 != 0 && hash1 != hash2) {
+            return false;
+        }
 
+        // Row by row so padding never takes part in the comparison
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
         for (int i = 0; i < matrix1.rows; i++) {
-            for (int j = 0; j < matrix1.cols; j++) {
-                if (matrix1.matrix[i][j] != matrix2.matrix[i][j]) {
-                    return false;
-                }
+            if (!kernels.equal(matrix1.rowPtr(i), matrix2.rowPtr(i), matrix1.cols)) {
+                return false;
             }
         }
         return true;
@@ -257,20 +608,16 @@ public:
 
     // Static method to create identity matrix
     static Matrix createIdentityMatrix(int size) {
+        MATRIX_INSTRUMENT("createIdentityMatrix");
         if (size <= 0) {
             std::cout << "Error: Invalid size for identity matrix!\n";
             return Matrix();
         }
 
+        // The constructor zero-fills, so only the diagonal needs writing
         Matrix result(size, size);
         for (int i = 0; i < size; i++) {
-            for (int j = 0; j < size; j++) {
-                if (i == j) {
-                    result.matrix[i][j] = 1;
-                } else {
-                    result.matrix[i][j] = 0;
-                }
-            }
+            result.rowPtr(i)[i] = T(1);
         }
         return result;
     }
@@ -289,6 +636,506 @@ public:
         std::cout << "Input Matrix (" << m1.getRows() << "x" << m1.getCols() << "):\n";
         m1.displayMatrix();
     }
+
+    // The same operations on views. A Matrix or MatrixView converts to a
+    // ConstMatrixView implicitly, and operands are read through their
+    // strides, so blocks and transposed views are never copied first:
+    // multiply(A.transposed(), B) packs A^T straight from A.
+    typedef ConstMatrixView<T> View;
+
+    static Matrix add(const View& view1, const View& view2) {
+        MATRIX_INSTRUMENT("add");
+        if (!sameShape("addition", view1, view2)) {
+            return Matrix();
+        }
+        Matrix result(view1.getRows(), view1.getCols());
+        addInto(result, view1, view2);
+        return result;
+    }
+
+    static Matrix subtract(const View& view1, const View& view2) {
+        MATRIX_INSTRUMENT("subtract");
+        if (!sameShape("subtraction", view1, view2)) {
+            return Matrix();
+        }
+        Matrix result(view1.getRows(), view1.getCols());
+        subtractInto(result, view1, view2);
+        return result;
+    }
+
+    static ProductMatrix multiply(const View& view1, const View& view2, int threads = 0, int grain = 0) {
+        MATRIX_INSTRUMENT("multiply");
+        if (view1.getCols() != view2.getRows()) {
+            std::cout << "Error: First matrix columns must equal second matrix rows for multiplication!\n";
+            std::cout << "Matrix 1: " << view1.getRows() << "x" << view1.getCols() << "\n";
+            std::cout << "Matrix 2: " << view2.getRows() << "x" << view2.getCols() << "\n";
+            return ProductMatrix();
+        }
+
+        ProductMatrix result(view1.getRows(), view2.getCols());
+        MATRIX_INSTRUMENT_GEMM(view1.getRows(), view2.getCols(), view1.getCols(), sizeof(T), sizeof(Acc),
+                               (GemmKernel<T, Acc>::plannedThreads(view1.getRows(), view2.getCols(),
+                                                                   view1.getCols(), threads)));
+        GemmKernel<T, Acc>::multiplyParallel(view1.getRows(), view2.getCols(), view1.getCols(),
+                                             view1.data(), view1.rowStride(), view1.colStride(),
+                                             view2.data(), view2.rowStride(), view2.colStride(),
+                                             result.matrix, result.rowStride, threads, grain);
+        return result;
+    }
+
+    // Strassen needs unit column strides; other views fall back to multiply()
+    static ProductMatrix multiplyStrassen(const View& view1, const View& view2, int crossover = 0) {
+        MATRIX_INSTRUMENT("multiplyStrassen");
+        StrassenWorkspace workspace;
+        return strassen(view1, view2, crossover, workspace, std::is_same<T, Acc>());
+    }
+
+    static Matrix scalarMultiply(const View& view1, T scalar) {
+        MATRIX_INSTRUMENT("scalarMultiply");
+        if (view1.isEmpty()) {
+            std::cout << "Error: Cannot perform scalar multiplication on empty matrix!\n";
+            return Matrix();
+        }
+
+        Matrix result(view1.getRows(), view1.getCols());
+        MATRIX_INSTRUMENT_ELEMENTWISE(view1.getRows(), view1.getCols(), 2, sizeof(T));
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        for (int i = 0; i < result.rows; i++) {
+            const T* a = view1.data() + i * view1.rowStride();
+            T* c = result.rowPtr(i);
+            if (view1.colStride() == 1) {
+                kernels.scale(a, scalar, c, result.cols);
+                continue;
+            }
+            for (int j = 0; j < result.cols; j++) {
+                c[j] = static_cast<T>(a[j * view1.colStride()] * scalar);
+            }
+        }
+        return result;
+    }
+
+    static Matrix transpose(const View& view1) {
+        MATRIX_INSTRUMENT("transpose");
+        if (view1.isEmpty()) {
+            std::cout << "Error: Cannot transpose empty matrix!\n";
+            return Matrix();
+        }
+        MATRIX_INSTRUMENT_WORK(static_cast<unsigned long long>(view1.getRows()) * view1.getCols(),
+                               2ULL * view1.getRows() * view1.getCols() * sizeof(T));
+        MATRIX_INSTRUMENT_KERNEL("transpose", nullptr, 1);
+        if (view1.colStride() == 1) {
+            Matrix result(view1.getCols(), view1.getRows());
+            TransposeKernel::transpose(view1.getRows(), view1.getCols(), view1.data(), view1.rowStride(),
+                                       result.matrix, result.rowStride);
+            return result;
+        }
+        // The transposed view reads rows contiguously when the original
+        // reads columns contiguously, and is a plain copy either way
+        return Matrix(view1.transposed());
+    }
+
+    static bool isEqual(const View& view1, const View& view2) {
+        MATRIX_INSTRUMENT("isEqual");
+        if (view1.getRows() != view2.getRows() || view1.getCols() != view2.getCols()) {
+            return false;
+        }
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        const bool contiguous = view1.colStride() == 1 && view2.colStride() == 1;
+        for (int i = 0; i < view1.getRows(); i++) {
+            if (contiguous) {
+                if (!kernels.equal(view1.data() + i * view1.rowStride(), view2.data() + i * view2.rowStride(),
+                                   view1.getCols())) {
+                    return false;
+                }
+                continue;
+            }
+            for (int j = 0; j < view1.getCols(); j++) {
+                if (view1(i, j) != view2(i, j)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static bool isSquare(const View& view1) {
+        return view1.getRows() == view1.getCols() && !view1.isEmpty();
+    }
+
+    // In-place variants writing into caller-owned storage (a Matrix or any
+    // view of one), so iterative code can reuse the same buffers every step.
+
+    // result = alpha * view1 * view2 + beta * result, with the scaling
+    // fused into the product's store. result must not overlap either
+    // operand; with beta == 0 its old contents are ignored.
+    static void multiplyInto(const MatrixView<Acc>& result, const View& view1, const View& view2,
+                             Acc alpha = Acc(1), Acc beta = Acc(0), int threads = 0, int grain = 0) {
+        MATRIX_INSTRUMENT("multiplyInto");
+        if (view1.getCols() != view2.getRows() || result.getRows() != view1.getRows()
+            || result.getCols() != view2.getCols()) {
+            std::cout << "Error: Cannot multiply " << view1.getRows() << "x" << view1.getCols() << " by "
+                      << view2.getRows() << "x" << view2.getCols() << " into a "
+                      << result.getRows() << "x" << result.getCols() << " matrix!\n";
+            return;
+        }
+        if (result.isEmpty()) {
+            return;
+        }
+        if (static_cast<const void*>(result.data()) == view1.data()
+            || static_cast<const void*>(result.data()) == view2.data()) {
+            std::cout << "Error: Result of multiplyInto must not alias an operand!\n";
+            return;
+        }
+        MATRIX_INSTRUMENT_GEMM(view1.getRows(), view2.getCols(), view1.getCols(), sizeof(T), sizeof(Acc),
+                               (GemmKernel<T, Acc>::plannedThreads(view1.getRows(), view2.getCols(),
+                                                                   view1.getCols(), threads)));
+
+        if (result.colStride() == 1) {
+            GemmKernel<T, Acc>::multiplyParallel(view1.getRows(), view2.getCols(), view1.getCols(), alpha,
+                                                 view1.data(), view1.rowStride(), view1.colStride(),
+                                                 view2.data(), view2.rowStride(), view2.colStride(),
+                                                 beta, result.data(), result.rowStride(), threads, grain);
+        } else if (result.rowStride() == 1) {
+            // A column-major result: compute its transpose, B^T A^T
+            GemmKernel<T, Acc>::multiplyParallel(view2.getCols(), view1.getRows(), view1.getCols(), alpha,
+                                                 view2.data(), view2.colStride(), view2.rowStride(),
+                                                 view1.data(), view1.colStride(), view1.rowStride(),
+                                                 beta, result.data(), result.colStride(), threads, grain);
+        } else {
+            std::cout << "Error: multiplyInto needs a result with unit row or column stride!\n";
+        }
+    }
+
+    // result = view1 + view2; result may be one of the operands, so
+    // addInto(C, C, A) accumulates A into C
+    static void addInto(const MatrixView<T>& result, const View& view1, const View& view2) {
+        MATRIX_INSTRUMENT("addInto");
+        if (sameShape("addition", view1, view2) && sameShape("addition", result, view1)) {
+            MATRIX_INSTRUMENT_ELEMENTWISE(view1.getRows(), view1.getCols(), 3, sizeof(T));
+            applyBinaryInto(SimdDispatch::kernels<T>().add, view1, view2, result,
+                            [](T x, T y) { return static_cast<T>(x + y); });
+        }
+    }
+
+    // result = view1 - view2; result may be one of the operands
+    static void subtractInto(const MatrixView<T>& result, const View& view1, const View& view2) {
+        MATRIX_INSTRUMENT("subtractInto");
+        if (sameShape("subtraction", view1, view2) && sameShape("subtraction", result, view1)) {
+            MATRIX_INSTRUMENT_ELEMENTWISE(view1.getRows(), view1.getCols(), 3, sizeof(T));
+            applyBinaryInto(SimdDispatch::kernels<T>().subtract, view1, view2, result,
+                            [](T x, T y) { return static_cast<T>(x - y); });
+        }
+    }
+
+    // A^exponent by repeated squaring: about 2 log2(exponent) products,
+    // each written into one of three buffers that are swapped rather than
+    // reallocated. exponent 0 gives the identity.
+    static ProductMatrix power(const View& view1, int exponent) {
+        MATRIX_INSTRUMENT("power");
+        if (!isSquare(view1) || exponent < 0) {
+            std::cout << "Error: Matrix power needs a square matrix and a non-negative exponent!\n";
+            return ProductMatrix();
+        }
+        return powerOf(view1, exponent, std::is_same<T, Acc>());
+    }
+
+    // Product of a chain of matrices, evaluated in the order with the
+    // fewest multiply-adds (see MatrixChainPlan) rather than left to right.
+    // Each intermediate is released as soon as its consumer is done.
+    static ProductMatrix multiplyChain(const std::vector<View>& matrices) {
+        MATRIX_INSTRUMENT("multiplyChain");
+        if (matrices.empty()) {
+            std::cout << "Error: Cannot multiply an empty chain!\n";
+            return ProductMatrix();
+        }
+        std::vector<int> dims(1, matrices[0].getRows());
+        for (std::size_t i = 0; i < matrices.size(); i++) {
+            if (matrices[i].getRows() != dims.back()) {
+                std::cout << "Error: Matrix " << i << " of the chain is " << matrices[i].getRows() << "x"
+                          << matrices[i].getCols() << " but must have " << dims.back() << " rows!\n";
+                return ProductMatrix();
+            }
+            dims.push_back(matrices[i].getCols());
+        }
+        return chainOf(matrices, MatrixChainPlan(dims), std::is_same<T, Acc>());
+    }
+
+    // matrix1 = scalar * matrix1
+    static void scaleInPlace(const MatrixView<T>& matrix1, T scalar) {
+        MATRIX_INSTRUMENT("scaleInPlace");
+        MATRIX_INSTRUMENT_ELEMENTWISE(matrix1.getRows(), matrix1.getCols(), 2, sizeof(T));
+        const ElementwiseKernels<T>& kernels = SimdDispatch::kernels<T>();
+        for (int i = 0; i < matrix1.getRows(); i++) {
+            T* row = matrix1.data() + i * matrix1.rowStride();
+            if (matrix1.colStride() == 1) {
+                kernels.scale(row, scalar, row, matrix1.getCols());
+                continue;
+            }
+            for (int j = 0; j < matrix1.getCols(); j++) {
+                row[j * matrix1.colStride()] = static_cast<T>(row[j * matrix1.colStride()] * scalar);
+            }
+        }
+    }
+
+    // P A = L U with partial pivoting (see LuKernel), computed in Real:
+    // lu receives L below the diagonal and U on and above it, pivots the
+    // row interchanges. Returns the sign of the permutation, or 0 if the
+    // matrix is singular.
+    static int luDecompose(const View& view1, RealMatrix& lu, std::vector<int>& pivots) {
+        MATRIX_INSTRUMENT("luDecompose");
+        if (!isSquare(view1)) {
+            std::cout << "Error: LU decomposition needs a square matrix!\n";
+            return 0;
+        }
+        lu = widen<Real>(view1);
+        MATRIX_INSTRUMENT_WORK(static_cast<unsigned long long>(lu.rows) * lu.rows * lu.rows / 3,
+                               static_cast<unsigned long long>(lu.rows) * lu.rows * sizeof(Real));
+        MATRIX_INSTRUMENT_KERNEL("lu", simdLevelName(SimdDispatch::level()),
+                                 GemmKernel<Real>::plannedThreads(lu.rows, lu.rows, LuKernel::BLOCK, 0));
+        pivots.assign(lu.rows, 0);
+        return LuKernel::factor(lu.rows, lu.matrix, lu.rowStride, pivots.data());
+    }
+
+    // Integer matrices get an exact fraction-free determinant; floating
+    // point ones the product of U's diagonal
+    static Determinant determinant(const View& view1) {
+        Determinant result = Determinant();
+        determinant(view1, result);
+        return result;
+    }
+
+    // As above, returning false (result 0) when view1 is not square or an
+    // integer determinant does not fit
+    static bool determinant(const View& view1, Determinant& result) {
+        MATRIX_INSTRUMENT("determinant");
+        result = Determinant();
+        if (!isSquare(view1)) {
+            std::cout << "Error: Determinant needs a square matrix!\n";
+            return false;
+        }
+        MATRIX_INSTRUMENT_WORK(static_cast<unsigned long long>(view1.getRows()) * view1.getRows() * view1.getRows() / 3,
+                               static_cast<unsigned long long>(view1.getRows()) * view1.getRows() * sizeof(T));
+        MATRIX_INSTRUMENT_KERNEL(std::is_integral<T>::value ? "bareiss" : "lu", nullptr, 1);
+        return determinantOf(view1, result, std::is_integral<T>());
+    }
+
+    static RealMatrix inverse(const View& view1) {
+        MATRIX_INSTRUMENT("inverse");
+        if (!isSquare(view1)) {
+            std::cout << "Error: Only square matrices can be inverted!\n";
+            return RealMatrix();
+        }
+        return solveWith(view1, BasicMatrixOperations<Real>::createIdentityMatrix(view1.getRows()));
+    }
+
+    // X with view1 X = view2, for any number of right-hand side columns
+    static RealMatrix solve(const View& view1, const View& view2) {
+        MATRIX_INSTRUMENT("solve");
+        if (!isSquare(view1) || view2.getRows() != view1.getRows() || view2.isEmpty()) {
+            std::cout << "Error: solve needs a square matrix and a right-hand side with as many rows!\n";
+            return RealMatrix();
+        }
+        return solveWith(view1, widen<Real>(view2));
+    }
+
+private:
+    static ProductMatrix strassen(const Matrix& matrix1, const Matrix& matrix2, int crossover,
+                                  StrassenWorkspace& workspace, std::true_type) {
+        if (!isSquare(matrix1) || !isSquare(matrix2) || matrix1.rows != matrix2.rows) {
+            return multiply(matrix1, matrix2);
+        }
+        if (crossover <= 0) {
+            crossover = StrassenMultiply::DEFAULT_CROSSOVER;
+        }
+
+        ProductMatrix result(matrix1.rows, matrix1.cols);
+        StrassenMultiply::multiply(matrix1.rows, matrix1.matrix, matrix1.rowStride,
+                                   matrix2.matrix, matrix2.rowStride,
+                                   result.matrix, result.rowStride, crossover, workspace);
+        return result;
+    }
+
+    static ProductMatrix strassen(const Matrix& matrix1, const Matrix& matrix2, int,
+                                  StrassenWorkspace&, std::false_type) {
+        return multiply(matrix1, matrix2);
+    }
+
+    static ProductMatrix strassen(const View& view1, const View& view2, int crossover,
+                                  StrassenWorkspace& workspace, std::true_type) {
+        if (!isSquare(view1) || view1.getRows() != view2.getRows() || view1.getCols() != view2.getCols()
+            || view1.colStride() != 1 || view2.colStride() != 1) {
+            return multiply(view1, view2);
+        }
+        if (crossover <= 0) {
+            crossover = StrassenMultiply::DEFAULT_CROSSOVER;
+        }
+
+        ProductMatrix result(view1.getRows(), view1.getCols());
+        StrassenMultiply::multiply(view1.getRows(), view1.data(), view1.rowStride(),
+                                   view2.data(), view2.rowStride(),
+                                   result.matrix, result.rowStride, crossover, workspace);
+        return result;
+    }
+
+    static ProductMatrix strassen(const View& view1, const View& view2, int,
+                                  StrassenWorkspace&, std::false_type) {
+        return multiply(view1, view2);
+    }
+
+    static ProductMatrix powerOf(const View& view1, int exponent, std::true_type) {
+        if (exponent == 0) {
+            return createIdentityMatrix(view1.getRows());
+        }
+        Matrix base(view1);
+        Matrix result;
+        Matrix scratch(base.rows, base.cols);
+        while (true) {
+            if (exponent & 1) {
+                if (result.isEmpty()) {
+                    result = base;
+                } else {
+                    multiplyInto(scratch, result, base);
+                    std::swap(result, scratch);
+                }
+            }
+            exponent >>= 1;
+            if (exponent == 0) {
+                return result;
+            }
+            multiplyInto(scratch, base, base);
+            std::swap(base, scratch);
+        }
+    }
+
+    // Narrow element types widen once up front and continue in Acc
+    static ProductMatrix powerOf(const View& view1, int exponent, std::false_type) {
+        return BasicMatrixOperations<Acc, Acc>::power(widen(view1), exponent);
+    }
+
+    static ProductMatrix chainOf(const std::vector<View>& matrices, const MatrixChainPlan& plan,
+                                 std::true_type) {
+        return chainRange(matrices, plan, 0, plan.size() - 1);
+    }
+
+    static ProductMatrix chainOf(const std::vector<View>& matrices, const MatrixChainPlan&,
+                                 std::false_type) {
+        std::vector<ProductMatrix> widened;
+        widened.reserve(matrices.size());
+        for (const View& m : matrices) {
+            widened.push_back(widen(m));
+        }
+        return BasicMatrixOperations<Acc, Acc>::multiplyChain(
+            std::vector<ConstMatrixView<Acc>>(widened.begin(), widened.end()));
+    }
+
+    // Product of matrices[i..j]; single matrices are used in place
+    static ProductMatrix chainRange(const std::vector<View>& matrices, const MatrixChainPlan& plan, int i, int j) {
+        if (i == j) {
+            return ProductMatrix(matrices[i]);
+        }
+        const int k = plan.split(i, j);
+        if (i == k && k + 1 == j) {
+            return multiply(matrices[i], matrices[j]);
+        }
+        if (i == k) {
+            return multiply(matrices[i], chainRange(matrices, plan, k + 1, j));
+        }
+        if (k + 1 == j) {
+            return multiply(chainRange(matrices, plan, i, k), matrices[j]);
+        }
+        return multiply(chainRange(matrices, plan, i, k), chainRange(matrices, plan, k + 1, j));
+    }
+
+    static bool determinantOf(const View& view1, Determinant& result, std::true_type) {
+        if (!LuKernel::bareissDeterminant(view1.getRows(), view1.data(), view1.rowStride(), view1.colStride(),
+                                          result)) {
+            std::cout << "Error: Determinant does not fit in a 64-bit integer!\n";
+            result = 0;
+            return false;
+        }
+        return true;
+    }
+
+    static bool determinantOf(const View& view1, Determinant& result, std::false_type) {
+        RealMatrix lu;
+        std::vector<int> pivots;
+        result = luDecompose(view1, lu, pivots);
+        for (int i = 0; i < lu.rows && result != 0; i++) {
+            result *= lu.rowPtr(i)[i];
+        }
+        return true;
+    }
+
+    // Overwrite the right-hand side with view1^-1 rhs
+    static RealMatrix solveWith(const View& view1, RealMatrix rhs) {
+        RealMatrix lu;
+        std::vector<int> pivots;
+        if (luDecompose(view1, lu, pivots) == 0) {
+            std::cout << "Error: Matrix is singular!\n";
+            return RealMatrix();
+        }
+        LuKernel::solve(lu.rows, lu.matrix, lu.rowStride, pivots.data(), rhs.cols, rhs.matrix, rhs.rowStride);
+        return rhs;
+    }
+
+    template <typename U = Acc>
+    static BasicMatrix<U> widen(const View& view1) {
+        BasicMatrix<U> result(view1.getRows(), view1.getCols());
+        for (int i = 0; i < result.rows; i++) {
+            U* row = result.rowPtr(i);
+            for (int j = 0; j < result.cols; j++) {
+                row[j] = static_cast<U>(view1(i, j));
+            }
+        }
+        return result;
+    }
+
+    // Run an elementwise kernel over same-shaped operands. Matrices with a
+    // common stride are processed as one flat buffer (padding included,
+    // which stays zero); otherwise row by row.
+    static void applyBinary(void (*kernel)(const T*, const T*, T*, std::size_t),
+                            const Matrix& matrix1, const Matrix& matrix2, Matrix& result) {
+        if (matrix1.rowStride == result.rowStride && matrix2.rowStride == result.rowStride) {
+            kernel(matrix1.matrix, matrix2.matrix, result.matrix, result.bufferSize());
+            return;
+        }
+        for (int i = 0; i < result.rows; i++) {
+            kernel(matrix1.rowPtr(i), matrix2.rowPtr(i), result.rowPtr(i), result.cols);
+        }
+    }
+
+    // View operands: the vector kernel for rows that are contiguous in
+    // all three, op element by element otherwise. Elements are read before
+    // the same position is written, so result may alias an operand.
+    template <typename Op>
+    static void applyBinaryInto(void (*kernel)(const T*, const T*, T*, std::size_t),
+                                const View& view1, const View& view2, const MatrixView<T>& result, Op op) {
+        const bool contiguous = view1.colStride() == 1 && view2.colStride() == 1 && result.colStride() == 1;
+        for (int i = 0; i < result.getRows(); i++) {
+            const T* a = view1.data() + i * view1.rowStride();
+            const T* b = view2.data() + i * view2.rowStride();
+            T* c = result.data() + i * result.rowStride();
+            if (contiguous) {
+                kernel(a, b, c, result.getCols());
+                continue;
+            }
+            for (int j = 0; j < result.getCols(); j++) {
+                c[j * result.colStride()] = op(a[j * view1.colStride()], b[j * view2.colStride()]);
+            }
+        }
+    }
+
+    static bool sameShape(const char* operation, const View& view1, const View& view2) {
+        if (view1.getRows() == view2.getRows() && view1.getCols() == view2.getCols()) {
+            return true;
+        }
+        std::cout << "Error: Matrices must have same dimensions for " << operation << "!\n";
+        std::cout << "Matrix 1: " << view1.getRows() << "x" << view1.getCols() << "\n";
+        std::cout << "Matrix 2: " << view2.getRows() << "x" << view2.getCols() << "\n";
+        return false;
+    }
 };
 
+typedef BasicMatrixOperations<int> MatrixOperations;
+
 #endif // MATRIX_UTILITY_H
\ No newline at end of file
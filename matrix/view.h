@@ -0,0 +1,141 @@
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// ConstMatrixView / MatrixView - non-owning windows onto matrix storage.
+//
+// A view is a pointer plus a shape and two strides: element (i, j) is at
+// data()[i * rowStride() + j * colStride()]. Blocks, single rows and
+// columns, and transposes (the strides swapped) are all views of the same
+// memory, so slicing never allocates or copies. A view must not outlive
+// the storage it looks at.
+//
+// Taking a sub-view checks its bounds once; a request outside the view is
+// reported and yields an empty view. Element access through operator() is
+// unchecked.
+template <typename T>
+class ConstMatrixView {
+protected:
+    const T* base;
+    int rows;
+    int cols;
+    std::ptrdiff_t rowStep;
+    std::ptrdiff_t colStep;
+
+    bool contains(int row, int col, int r, int c) const {
+        if (row >= 0 && col >= 0 && r >= 0 && c >= 0 && row + r <= rows && col + c <= cols) {
+            return true;
+        }
+        std::cout << "Error: Block at (" << row << ", " << col << ") of size " << r << "x" << c
+                  << " is outside the " << rows << "x" << cols << " matrix!\n";
+        return false;
+    }
+
+    const T* at(int i, int j) const { return base + i * rowStep + j * colStep; }
+
+public:
+    typedef T value_type;
+
+    ConstMatrixView() : base(nullptr), rows(0), cols(0), rowStep(0), colStep(0) {}
+
+    ConstMatrixView(const T* data, int r, int c, std::ptrdiff_t rowStride, std::ptrdiff_t colStride = 1)
+        : base(data), rows(r), cols(c), rowStep(rowStride), colStep(colStride) {
+        if (base == nullptr || rows <= 0 || cols <= 0) {
+            base = nullptr;
+            rows = 0;
+            cols = 0;
+        }
+    }
+
+    int getRows() const { return rows; }
+    int getCols() const { return cols; }
+    std::ptrdiff_t rowStride() const { return rowStep; }
+    std::ptrdiff_t colStride() const { return colStep; }
+    const T* data() const { return base; }
+    bool isEmpty() const { return base == nullptr; }
+
+    T operator()(int i, int j) const { return *at(i, j); }
+
+    T getElement(int row, int col) const {
+        return (row >= 0 && row < rows && col >= 0 && col < cols) ? *at(row, col) : T();
+    }
+
+    // r x c block starting at (row, col)
+    ConstMatrixView block(int row, int col, int r, int c) const {
+        return contains(row, col, r, c) ? ConstMatrixView(at(row, col), r, c, rowStep, colStep) : ConstMatrixView();
+    }
+
+    ConstMatrixView row(int i) const { return block(i, 0, 1, cols); }
+    ConstMatrixView col(int j) const { return block(0, j, rows, 1); }
+
+    ConstMatrixView transposed() const { return ConstMatrixView(base, cols, rows, colStep, rowStep); }
+};
+
+template <typename T>
+class MatrixView : public ConstMatrixView<T> {
+private:
+    typedef ConstMatrixView<T> Base;
+
+    T* at(int i, int j) const { return const_cast<T*>(Base::at(i, j)); }
+
+public:
+    MatrixView() {}
+
+    MatrixView(T* data, int r, int c, std::ptrdiff_t rowStride, std::ptrdiff_t colStride = 1)
+        : Base(data, r, c, rowStride, colStride) {}
+
+    T* data() const { return const_cast<T*>(this->base); }
+
+    T& operator()(int i, int j) const { return *at(i, j); }
+
+    void setElement(int row, int col, T value) const {
+        if (row >= 0 && row < this->rows && col >= 0 && col < this->cols) {
+            *at(row, col) = value;
+        }
+    }
+
+    MatrixView block(int row, int col, int r, int c) const {
+        return this->contains(row, col, r, c) ? MatrixView(at(row, col), r, c, this->rowStep, this->colStep)
+                                              : MatrixView();
+    }
+
+    MatrixView row(int i) const { return block(i, 0, 1, this->cols); }
+    MatrixView col(int j) const { return block(0, j, this->rows, 1); }
+
+    MatrixView transposed() const {
+        return MatrixView(data(), this->cols, this->rows, this->colStep, this->rowStep);
+    }
+
+    // Copy a same-shaped view into this one; the two must not overlap
+    void assign(const ConstMatrixView<T>& source) const {
+        if (source.getRows() != this->rows || source.getCols() != this->cols) {
+            std::cout << "Error: Cannot assign a " << source.getRows() << "x" << source.getCols()
+                      << " view to a " << this->rows << "x" << this->cols << " view!\n";
+            return;
+        }
+        const bool contiguous = this->colStep == 1 && source.colStride() == 1;
+        for (int i = 0; i < this->rows; i++) {
+            if (contiguous) {
+                std::memcpy(at(i, 0), source.data() + i * source.rowStride(),
+                            static_cast<std::size_t>(this->cols) * sizeof(T));
+                continue;
+            }
+            for (int j = 0; j < this->cols; j++) {
+                *at(i, j) = source(i, j);
+            }
+        }
+    }
+
+    void fill(T value) const {
+        for (int i = 0; i < this->rows; i++) {
+            for (int j = 0; j < this->cols; j++) {
+                *at(i, j) = value;
+            }
+        }
+    }
+};
+
+#endif // MATRIX_VIEW_H